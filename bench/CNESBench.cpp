@@ -0,0 +1,713 @@
+#include <CNES_Machine.h>
+#include <CNES_Cartridge.h>
+#include <CNES_CPU.h>
+#include <CNES_PPU.h>
+#include <CNES_Palette.h>
+#include <CNES_NTSC.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// Benchmarks for core hot paths
+//
+// Micro benchmarks time single calls (bus dispatch, line drawing, sprite
+// evaluation, VRAM reads, mapper writes) against a machine running a synthetic
+// ROM. Macro benchmarks run a synthetic ROM for a fixed number of frames with
+// a fixed input movie. All ROMs are assembled here so results don't depend on
+// external files.
+
+using namespace CNES;
+
+namespace {
+
+using Data = std::vector<uchar>;
+
+//---
+
+// minimal 6502 assembler (enough for the synthetic ROMs)
+class Assembler {
+ public:
+  Assembler(ushort org) : org_(org) { }
+
+  const Data &code() const { return code_; }
+
+  ushort pc() const { return ushort(org_ + code_.size()); }
+
+  void op(uchar o) { code_.push_back(o); }
+
+  void op8(uchar o, uchar v) { op(o); op(v); }
+
+  void op16(uchar o, ushort v) { op(o); op(v & 0xFF); op(v >> 8); }
+
+  // branch back to address
+  void branch(uchar o, ushort addr) {
+    op8(o, uchar(int(addr) - int(pc() + 2)));
+  }
+
+  // forward branch (returns position to patch)
+  size_t branchForward(uchar o) {
+    op8(o, 0);
+
+    return code_.size() - 1;
+  }
+
+  void patch(size_t pos) {
+    code_[pos] = uchar(code_.size() - pos - 1);
+  }
+
+ private:
+  ushort org_ { 0 };
+  Data   code_;
+};
+
+// 6502 opcodes used
+enum : uchar {
+  OP_AND_IMM = 0x29, OP_BEQ     = 0xF0, OP_BNE     = 0xD0, OP_CLD     = 0xD8,
+  OP_CPX_IMM = 0xE0, OP_DEX     = 0xCA, OP_DEY     = 0x88, OP_INC_ZP  = 0xE6,
+  OP_INX     = 0xE8, OP_JMP     = 0x4C, OP_LDA_IMM = 0xA9, OP_LDA_ZP  = 0xA5,
+  OP_LDA_ABS = 0xAD, OP_LDX_IMM = 0xA2, OP_LDY_IMM = 0xA0, OP_LSR_A   = 0x4A,
+  OP_PHA     = 0x48, OP_PLA     = 0x68, OP_ROL_ZP  = 0x26, OP_RTI     = 0x40,
+  OP_SEI     = 0x78, OP_STA_ABS = 0x8D, OP_STA_ABX = 0x9D, OP_STA_ZP  = 0x85,
+  OP_TXA     = 0x8A, OP_TXS     = 0x9A
+};
+
+// Build iNES image of a small game-like program: fills name table, palette
+// and sprites at reset, then each NMI does OAM DMA, reads controller 1, scrolls
+// while right is held, moves sprite 0 and (MMC1) switches PRG bank.
+Data
+buildROM(int mapper)
+{
+  int numPrg = (mapper == 1 ? 2 : 1);
+
+  // program in upper (fixed) bank
+  Assembler a(0xC000);
+
+  // reset
+  ushort reset = a.pc();
+
+  a.op(OP_SEI); a.op(OP_CLD);
+  a.op8(OP_LDX_IMM, 0xFF); a.op(OP_TXS);
+  a.op8(OP_LDA_IMM, 0x00); a.op16(OP_STA_ABS, 0x2000); a.op16(OP_STA_ABS, 0x2001);
+
+  // name and attribute table ($2000-$23FF)
+  a.op8(OP_LDA_IMM, 0x20); a.op16(OP_STA_ABS, 0x2006);
+  a.op8(OP_LDA_IMM, 0x00); a.op16(OP_STA_ABS, 0x2006);
+  a.op8(OP_LDX_IMM, 0x00); a.op8(OP_LDY_IMM, 0x04);
+
+  ushort ntLoop = a.pc();
+
+  a.op(OP_TXA); a.op16(OP_STA_ABS, 0x2007); a.op(OP_INX);
+  a.branch(OP_BNE, ntLoop); a.op(OP_DEY); a.branch(OP_BNE, ntLoop);
+
+  // palette ($3F00-$3F1F)
+  a.op8(OP_LDA_IMM, 0x3F); a.op16(OP_STA_ABS, 0x2006);
+  a.op8(OP_LDA_IMM, 0x00); a.op16(OP_STA_ABS, 0x2006);
+  a.op8(OP_LDX_IMM, 0x00);
+
+  ushort palLoop = a.pc();
+
+  a.op(OP_TXA); a.op16(OP_STA_ABS, 0x2007); a.op(OP_INX);
+  a.op8(OP_CPX_IMM, 0x20); a.branch(OP_BNE, palLoop);
+
+  // sprites ($0200-$02FF, spread over screen)
+  a.op8(OP_LDX_IMM, 0x00);
+
+  ushort sprLoop = a.pc();
+
+  a.op(OP_TXA); a.op16(OP_STA_ABX, 0x0200); a.op(OP_INX);
+  a.branch(OP_BNE, sprLoop);
+
+  // enable NMI, background and sprites
+  a.op8(OP_LDA_IMM, 0x80); a.op16(OP_STA_ABS, 0x2000);
+  a.op8(OP_LDA_IMM, 0x1E); a.op16(OP_STA_ABS, 0x2001);
+
+  ushort mainLoop = a.pc();
+
+  a.op8(OP_INC_ZP, 0x10); a.op16(OP_JMP, mainLoop);
+
+  // nmi
+  ushort nmi = a.pc();
+
+  a.op(OP_PHA);
+
+  // sprite DMA
+  a.op8(OP_LDA_IMM, 0x02); a.op16(OP_STA_ABS, 0x4014);
+
+  // read controller 1 into $00 (A in bit 7, right in bit 0)
+  a.op8(OP_LDA_IMM, 0x01); a.op16(OP_STA_ABS, 0x4016);
+  a.op8(OP_LDA_IMM, 0x00); a.op16(OP_STA_ABS, 0x4016);
+  a.op8(OP_LDX_IMM, 0x08);
+
+  ushort joyLoop = a.pc();
+
+  a.op16(OP_LDA_ABS, 0x4016); a.op(OP_LSR_A); a.op8(OP_ROL_ZP, 0x00);
+  a.op(OP_DEX); a.branch(OP_BNE, joyLoop);
+
+  // scroll while right held
+  a.op8(OP_LDA_ZP, 0x00); a.op8(OP_AND_IMM, 0x01);
+
+  size_t noScroll = a.branchForward(OP_BEQ);
+
+  a.op8(OP_INC_ZP, 0x01);
+
+  a.patch(noScroll);
+
+  a.op8(OP_LDA_ZP, 0x01); a.op16(OP_STA_ABS, 0x2005);
+  a.op8(OP_LDA_IMM, 0x00); a.op16(OP_STA_ABS, 0x2005);
+
+  // move sprite 0
+  a.op16(OP_LDA_ABS, 0x0200); a.op8(OP_STA_ZP, 0x02); a.op8(OP_INC_ZP, 0x02);
+  a.op8(OP_LDA_ZP, 0x02); a.op16(OP_STA_ABS, 0x0200);
+
+  // MMC1: serial write of frame count bit 0 to PRG bank register ($E000)
+  if (mapper == 1) {
+    a.op8(OP_LDA_ZP, 0x02);
+
+    for (int i = 0; i < 5; ++i)
+      a.op16(OP_STA_ABS, 0xE000);
+  }
+
+  a.op(OP_PLA);
+
+  ushort irq = a.pc();
+
+  a.op(OP_RTI);
+
+  //---
+
+  Data rom;
+
+  // header (vertical mirroring)
+  Data header = { 0x4E, 0x45, 0x53, 0x1A, uchar(numPrg), 1, uchar(((mapper & 0x0F) << 4) | 0x01),
+                  uchar(mapper & 0xF0), 1, 0, 0, 0, 0, 0, 0, 0 };
+
+  rom.insert(rom.end(), header.begin(), header.end());
+
+  // PRG ROM (lower banks unused, upper bank contains code and vectors)
+  Data prg(numPrg*0x4000, 0xEA);
+
+  const auto &code = a.code();
+
+  size_t upper = (numPrg - 1)*0x4000;
+
+  std::copy(code.begin(), code.end(), prg.begin() + upper);
+
+  auto setVector = [&](ushort addr, ushort value) {
+    prg[upper + addr - 0xC000    ] = value & 0xFF;
+    prg[upper + addr - 0xC000 + 1] = value >> 8;
+  };
+
+  setVector(0xFFFA, nmi);
+  setVector(0xFFFC, reset);
+  setVector(0xFFFE, irq);
+
+  rom.insert(rom.end(), prg.begin(), prg.end());
+
+  // CHR ROM (pseudo random tile patterns)
+  uint seed = 12345;
+
+  for (int i = 0; i < 0x2000; ++i) {
+    seed = seed*1103515245 + 12345;
+
+    rom.push_back(uchar(seed >> 16));
+  }
+
+  return rom;
+}
+
+//---
+
+// per-frame controller 1 button state
+using Movie = std::vector<uchar>;
+
+Movie
+buildMovie(const std::string &name, int numFrames)
+{
+  Movie movie(numFrames, 0);
+
+  if      (name == "scroll") {
+    for (int i = 0; i < numFrames; ++i)
+      movie[i] = Input::BUTTON_RIGHT;
+  }
+  else if (name == "mash") {
+    uint seed = 1;
+
+    for (int i = 0; i < numFrames; ++i) {
+      seed = seed*1103515245 + 12345;
+
+      movie[i] = uchar(seed >> 16);
+    }
+  }
+
+  return movie;
+}
+
+//---
+
+struct Result {
+  std::string name;
+  ulong       iterations { 0 };
+  double      nsPerOp    { 0.0 };
+};
+
+struct Options {
+  std::string filter;
+  int         repeats { 5 };
+  int         frames  { 600 };
+  double      minTime { 0.1 }; // minimum seconds per timed run
+};
+
+using Results = std::vector<Result>;
+
+// elapsed seconds of call to func
+double
+timeRun(const std::function<void()> &func)
+{
+  using Clock = std::chrono::steady_clock;
+
+  auto t1 = Clock::now();
+
+  func();
+
+  auto t2 = Clock::now();
+
+  return std::chrono::duration<double>(t2 - t1).count();
+}
+
+// best elapsed seconds of repeated calls to func
+double
+bestTime(const Options &options, const std::function<void()> &func)
+{
+  double best = 0.0;
+
+  for (int i = 0; i < options.repeats; ++i) {
+    double t = timeRun(func);
+
+    if (i == 0 || t < best)
+      best = t;
+  }
+
+  return best;
+}
+
+// time n calls of func (best of repeats, iterations grown to reach min time)
+Result
+runBench(const std::string &name, const Options &options, const std::function<void(ulong)> &func)
+{
+  ulong n = 1;
+
+  while (timeRun([&]() { func(n); }) < options.minTime && n < (1UL << 40))
+    n *= 2;
+
+  double best = bestTime(options, [&]() { func(n); });
+
+  Result result;
+
+  result.name       = name;
+  result.iterations = n;
+  result.nsPerOp    = 1e9*best/double(n);
+
+  std::cout << name << ": " << result.nsPerOp << " ns/op (" << n << " iterations)\n";
+
+  return result;
+}
+
+// machine running synthetic ROM (a few frames so ppu memory is set up)
+bool
+initMachine(Machine &machine, int mapper)
+{
+  machine.init();
+
+  machine.pacer().setMode(Pacer::Mode::UNTHROTTLED);
+
+  if (! machine.getCart()->loadNESData(buildROM(mapper)))
+    return false;
+
+  machine.getCPU()->resetSystem();
+
+  for (int i = 0; i < 4; ++i)
+    machine.runFrame();
+
+  return true;
+}
+
+void
+runMicroBenchmarks(const Options &options, Results &results)
+{
+  auto add = [&](const std::string &name, const std::function<void(ulong)> &func) {
+    if (options.filter != "" && name.find(options.filter) == std::string::npos)
+      return;
+
+    results.push_back(runBench(name, options, func));
+  };
+
+  Machine machine;
+
+  if (! initMachine(machine, 0)) {
+    std::cerr << "Failed to load synthetic ROM\n";
+    return;
+  }
+
+  auto *cpu  = machine.getCPU();
+  auto *ppu  = machine.getPPU();
+  auto *cart = machine.getCart();
+
+  volatile uchar sink = 0;
+
+  //---
+
+  // bus dispatch (RAM, PPU register, ROM)
+  add("cpu_getByte", [&](ulong n) {
+    static const ushort addrs[] = { 0x0010, 0x0200, 0x2002, 0x4016, 0x8000, 0xC123, 0xFFFC, 0x07FF };
+
+    uchar c = 0;
+
+    for (ulong i = 0; i < n; ++i)
+      c += cpu->getByte(addrs[i & 7]);
+
+    sink = c;
+  });
+
+  add("cpu_setByte", [&](ulong n) {
+    static const ushort addrs[] = { 0x0010, 0x0300, 0x0400, 0x2003, 0x4000, 0x0500, 0x4002, 0x07FF };
+
+    for (ulong i = 0; i < n; ++i)
+      cpu->setByte(addrs[i & 7], uchar(i));
+  });
+
+  //---
+
+  // draw visible lines (PPUMASK set per variant, scroll from frames run with
+  // right held as synthetic ROM scrolls one pixel per frame)
+  auto drawLines = [&](uchar mask, int scrollFrames) {
+    ppu->setControlByte(0x2001, mask);
+
+    machine.input().setButtons(0, Input::BUTTON_RIGHT);
+
+    for (int i = 0; i < scrollFrames; ++i)
+      machine.runFrame();
+
+    machine.input().setButtons(0, 0);
+
+    machine.runFrame();
+
+    return [=](ulong n) {
+      int y1 = PPU::topMargin();
+      int nl = PPU::visibleLines();
+
+      for (ulong i = 0; i < n; ++i)
+        ppu->drawLine(y1 + int(i % nl));
+    };
+  };
+
+  add("ppu_drawLine_bg"     , drawLines(0x0A, 0 ));
+  add("ppu_drawLine_sprites", drawLines(0x1E, 0 ));
+  add("ppu_drawLine_scroll" , drawLines(0x1E, 37));
+
+  // skipped frame lines (sprite 0 hit and overflow only)
+  auto skipLines = drawLines(0x1E, 0);
+
+  ppu->setFrameSkip(1 << 30);
+
+  add("ppu_skipLine_sprites", skipLines);
+
+  ppu->setFrameSkip(0);
+
+  //---
+
+  // sprite evaluation with n sprites on line 100
+  auto drawSprites = [&](int numSprites) {
+    ppu->setControlByte(0x2001, 0x1E);
+    ppu->setControlByte(0x2003, 0x00);
+
+    for (int i = 0; i < 64; ++i) {
+      bool onLine = (i < numSprites);
+
+      ppu->setControlByte(0x2004, onLine ? 96 : 0xF0); // y
+      ppu->setControlByte(0x2004, uchar(i));           // tile
+      ppu->setControlByte(0x2004, uchar(i & 0x03));    // attributes
+      ppu->setControlByte(0x2004, uchar(i*4));         // x
+    }
+
+    return [=](ulong n) {
+      for (ulong i = 0; i < n; ++i)
+        ppu->drawSpritesOnLine(100);
+    };
+  };
+
+  add("ppu_drawSpritesOnLine_0" , drawSprites(0 ));
+  add("ppu_drawSpritesOnLine_8" , drawSprites(8 ));
+  add("ppu_drawSpritesOnLine_64", drawSprites(64));
+
+  //---
+
+  // PPUSTATUS polling at line 100 with sprite 0 below (lines tested for sprite 0
+  // hit once, then cached)
+  auto readStatus = [&]() {
+    ppu->setControlByte(0x2001, 0x1E);
+    ppu->setControlByte(0x2003, 0x00);
+    ppu->setControlByte(0x2004, 200);
+
+    machine.runFrame();
+
+    int ticks = (PPU::topMargin() + 100)*341/3;
+
+    for (int i = 0; i < ticks; ++i)
+      ppu->tick(1);
+
+    return [&](ulong n) {
+      uchar c = 0;
+
+      for (ulong i = 0; i < n; ++i)
+        c += ppu->getControlByte(0x2002);
+
+      sink = c;
+    };
+  };
+
+  add("ppu_readStatus", readStatus());
+
+  //---
+
+  // screen conversion to frame buffer format (whole screen per op)
+  auto convertScreen = [&](Palette::Format format) {
+    int w = PPU::visiblePixels();
+    int h = PPU::visibleLines();
+
+    int stride = w*Palette::bytesPerPixel(format);
+
+    Data buffer(size_t(stride)*h);
+
+    return [=](ulong n) mutable {
+      for (ulong i = 0; i < n; ++i)
+        Palette::convert(ppu->screenPixels(), w, h, w, format, &buffer[0], stride);
+
+      sink = buffer[size_t(n) % buffer.size()];
+    };
+  };
+
+  bool simd = Palette::isSIMD();
+
+  add("palette_convert_bgra"    , convertScreen(Palette::Format::BGRA8888));
+  add("palette_convert_rgb565"  , convertScreen(Palette::Format::RGB565  ));
+  add("palette_convert_indexed8", convertScreen(Palette::Format::INDEXED8));
+
+  Palette::setSIMD(false);
+
+  add("palette_convert_bgra_scalar"  , convertScreen(Palette::Format::BGRA8888));
+  add("palette_convert_rgb565_scalar", convertScreen(Palette::Format::RGB565  ));
+
+  Palette::setSIMD(simd);
+
+  //---
+
+  // NTSC composite filter of whole screen (single thread and default threads)
+  auto ntscFilter = [&](int numThreads) {
+    auto filter = std::make_shared<NTSCFilter>(numThreads);
+
+    int w = PPU::visiblePixels();
+    int h = PPU::visibleLines();
+
+    int stride = NTSCFilter::outputWidth(w)*4;
+
+    Data buffer(size_t(stride)*h);
+
+    return [=](ulong n) mutable {
+      for (ulong i = 0; i < n; ++i)
+        filter->filter(ppu->screenPixels(), w, h, w, i, Palette::Format::BGRA8888,
+                       &buffer[0], stride);
+
+      sink = buffer[size_t(n) % buffer.size()];
+    };
+  };
+
+  add("ntsc_filter"        , ntscFilter(1));
+  add("ntsc_filter_threads", ntscFilter(0));
+
+  //---
+
+  add("cart_getVRAMByte", [&](ulong n) {
+    uchar c1 = 0, c;
+
+    for (ulong i = 0; i < n; ++i) {
+      cart->getVRAMByte(ushort((i*17) & 0x1FFF), c);
+
+      c1 += c;
+    }
+
+    sink = c1;
+  });
+
+  //---
+
+  // MMC1 serial writes (every 5th write switches PRG bank)
+  Machine machine1;
+
+  if (initMachine(machine1, 1)) {
+    auto *cpu1 = machine1.getCPU();
+
+    add("mmc1_write", [&](ulong n) {
+      for (ulong i = 0; i < n; ++i)
+        cpu1->setByte(0xE000, uchar((i / 5) & 0x01));
+    });
+  }
+}
+
+void
+runMacroBenchmarks(const Options &options, Results &results)
+{
+  // movie and frame skip (draw every frame or one in four for fast forward)
+  struct Run {
+    const char *movie;
+    int         frameSkip;
+  };
+
+  static const Run runs[] = {
+    { "idle", 0 }, { "scroll", 0 }, { "mash", 0 },
+    { "idle", 3 }, { "scroll", 3 }, { "mash", 3 },
+  };
+
+  for (int mapper : { 0, 1 }) {
+    Data rom = buildROM(mapper);
+
+    for (const auto &run : runs) {
+      std::string name = std::string("frames_") + (mapper == 1 ? "mmc1" : "nrom") + "_" + run.movie;
+
+      if (run.frameSkip > 0)
+        name += "_skip" + std::to_string(run.frameSkip);
+
+      if (options.filter != "" && name.find(options.filter) == std::string::npos)
+        continue;
+
+      Movie movie = buildMovie(run.movie, options.frames);
+
+      // fixed length run (iteration count is number of frames)
+      double best = bestTime(options, [&]() {
+        Machine machine;
+
+        machine.init();
+
+        machine.pacer().setMode(Pacer::Mode::UNTHROTTLED);
+
+        machine.getPPU()->setFrameSkip(run.frameSkip);
+
+        machine.getCart()->loadNESData(rom);
+
+        machine.getCPU()->resetSystem();
+
+        for (const auto &buttons : movie) {
+          machine.input().setButtons(0, buttons);
+
+          if (! machine.runFrame())
+            break;
+        }
+      });
+
+      Result result;
+
+      result.name       = name;
+      result.iterations = movie.size();
+      result.nsPerOp    = 1e9*best/double(movie.size());
+
+      std::cout << name << ": " << result.nsPerOp << " ns/frame (" <<
+        1e9/result.nsPerOp << " fps)\n";
+
+      results.push_back(result);
+    }
+  }
+}
+
+void
+writeJSON(std::ostream &os, const Results &results)
+{
+  os << "{\n  \"benchmarks\": [\n";
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto &result = results[i];
+
+    os << "    { \"name\": \"" << result.name << "\", \"iterations\": " << result.iterations <<
+          ", \"ns_per_op\": " << result.nsPerOp << ", \"ops_per_sec\": " <<
+          (result.nsPerOp > 0.0 ? 1e9/result.nsPerOp : 0.0) << " }" <<
+          (i + 1 < results.size() ? "," : "") << "\n";
+  }
+
+  os << "  ]\n}\n";
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  bool        micro = true;
+  bool        macro = true;
+  std::string jsonFile;
+
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      std::string arg = &argv[i][1];
+
+      if      (arg == "micro")
+        macro = false;
+      else if (arg == "macro")
+        micro = false;
+      else if (arg == "filter") {
+        if (i < argc - 1)
+          options.filter = argv[++i];
+      }
+      else if (arg == "frames") {
+        if (i < argc - 1)
+          options.frames = std::max(std::atoi(argv[++i]), 1);
+      }
+      else if (arg == "repeats") {
+        if (i < argc - 1)
+          options.repeats = std::max(std::atoi(argv[++i]), 1);
+      }
+      else if (arg == "json") {
+        if (i < argc - 1)
+          jsonFile = argv[++i];
+      }
+      else {
+        std::cerr << "Invalid arg '" << argv[i] << "'\n";
+        exit(1);
+      }
+    }
+    else {
+      std::cerr << "Invalid arg '" << argv[i] << "'\n";
+      exit(1);
+    }
+  }
+
+  //---
+
+  Results results;
+
+  if (micro)
+    runMicroBenchmarks(options, results);
+
+  if (macro)
+    runMacroBenchmarks(options, results);
+
+  if (jsonFile == "-")
+    writeJSON(std::cout, results);
+  else if (jsonFile != "") {
+    std::ofstream os(jsonFile);
+
+    if (! os) {
+      std::cerr << "Failed to open '" << jsonFile << "'\n";
+      exit(1);
+    }
+
+    writeJSON(os, results);
+  }
+
+  return 0;
+}
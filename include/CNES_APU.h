@@ -0,0 +1,241 @@
+#ifndef CNES_APU_H
+#define CNES_APU_H
+
+#include <CNES_Types.h>
+#include <CNES_BlipBuffer.h>
+
+namespace CNES {
+
+class Machine;
+
+// Audio Processing Unit (2 pulse, triangle, noise, DMC and frame counter)
+//
+// The APU is not clocked every cpu cycle. Channel state is caught up (run) to the
+// current cpu cycle only when a register is written/read or samples are drained,
+// stepping each channel from one timer event to the next and adding band-limited
+// steps to the output buffer when the mixed output changes. Silent channels are
+// not stepped at all.
+class APU {
+ public:
+  static const ulong s_never = ~0UL;
+
+ public:
+  APU(Machine *machine);
+
+  virtual ~APU();
+
+  bool isDebugWrite() const { return debugWrite_; }
+  void setDebugWrite(bool b) { debugWrite_ = b; }
+
+  //---
+
+  // registers ($4000-$4013, $4015, $4017)
+  void setByte(ushort addr, uchar c);
+
+  // status ($4015) read (clears frame interrupt)
+  uchar getStatus();
+  uchar peekStatus() const;
+
+  bool isFrameIRQ() const { return frameIRQ_; }
+  bool isDmcIRQ  () const { return dmc_.irq; }
+
+  // cpu IRQ line (frame or DMC interrupt pending)
+  bool isIRQ() const { return frameIRQ_ || dmc_.irq; }
+
+  // cpu cycle at which frame interrupt is next raised, s_never if none (5 step mode,
+  // inhibited or already pending). Only changes on register access and when the
+  // interrupt is raised so cpu can cache it and compare each tick.
+  ulong frameIRQTime() const;
+
+  // catch up to and raise frame interrupt at cpu cycle (called by cpu at irq time)
+  void runFrameIRQ(ulong time);
+
+  //---
+
+  // cpu cycle of next DMC sample fetch (DMA), s_never if none pending. Only changes
+  // on register writes and fetches so cpu can cache it and compare each tick.
+  ulong dmcFetchTime() const;
+
+  // catch up to and perform DMC fetch at cpu cycle (called by cpu at fetch time)
+  void runDMCFetch(ulong time);
+
+  // number of DMC sample fetches
+  ulong numDMCFetches() const { return numDMCFetches_; }
+
+  //---
+
+  // audio output
+  int sampleRate() const { return blip_.sampleRate(); }
+  void setSampleRate(int rate);
+
+  double clockRate() const { return blip_.clockRate(); }
+  void setClockRate(double rate);
+
+  // catch up to current cpu cycle and make samples available
+  void endFrame();
+
+  int samplesAvail() const { return blip_.samplesAvail(); }
+
+  int readSamples(short *out, int n);
+
+  //---
+
+  void reset();
+
+ protected:
+  struct Envelope {
+    bool  start    { false };
+    bool  loop     { false }; // also length counter halt
+    bool  constant { false };
+    uchar volume   { 0 };     // constant volume or envelope period
+    uchar divider  { 0 };
+    uchar decay    { 0 };
+
+    uchar output() const { return (constant ? volume : decay); }
+
+    void clock();
+  };
+
+  struct Pulse {
+    bool     ones     { false }; // pulse 1 (sweep negate uses ones' complement)
+    bool     enabled  { false };
+    uchar    duty     { 0 };
+    ushort   timer    { 0 };     // 11 bit period
+    uchar    length   { 0 };
+    uchar    pos      { 0 };     // sequencer position (0-7)
+    Envelope envelope;
+
+    bool  sweepEnabled { false };
+    uchar sweepPeriod  { 0 };
+    bool  sweepNegate  { false };
+    uchar sweepShift   { 0 };
+    bool  sweepReload  { false };
+    uchar sweepDivider { 0 };
+
+    ulong nextTime { s_never };
+
+    int  sweepTarget() const;
+    bool isMuted() const;
+    bool isActive() const;
+
+    uchar output() const;
+
+    ulong period() const { return (ulong(timer) + 1)*2; }
+
+    void step() { pos = (pos + 1) & 0x07; nextTime += period(); }
+
+    void clockSweep();
+  };
+
+  struct Triangle {
+    bool   enabled       { false };
+    bool   control       { false }; // also length counter halt
+    uchar  linearLoad    { 0 };
+    uchar  linear        { 0 };
+    bool   linearReload  { false };
+    ushort timer         { 0 };
+    uchar  length        { 0 };
+    uchar  pos           { 0 };     // sequencer position (0-31)
+    ulong  nextTime      { s_never };
+
+    bool isActive() const;
+
+    uchar output() const;
+
+    ulong period() const { return ulong(timer) + 1; }
+
+    void step() { pos = (pos + 1) & 0x1F; nextTime += period(); }
+
+    void clockLinear();
+  };
+
+  struct Noise {
+    bool     enabled  { false };
+    bool     mode     { false };
+    uchar    rate     { 0 };
+    ushort   shift    { 1 };     // 15 bit LFSR
+    uchar    length   { 0 };
+    Envelope envelope;
+    ulong    nextTime { s_never };
+
+    bool isActive() const;
+
+    uchar output() const;
+
+    ulong period() const;
+
+    void step();
+  };
+
+  struct DMC {
+    bool   irqEnabled     { false };
+    bool   irq            { false };
+    bool   loop           { false };
+    uchar  rate           { 0 };
+    uchar  level          { 0 };     // 7 bit output level
+    ushort sampleAddr     { 0xC000 };
+    ushort sampleLength   { 1 };
+    ushort addr           { 0xC000 }; // current fetch address
+    ushort bytesRemaining { 0 };
+    uchar  buffer         { 0 };     // sample buffer
+    bool   bufferFull     { false };
+    uchar  shift          { 0 };     // output shift register
+    uchar  bitsRemaining  { 8 };
+    bool   silence        { true };
+    ulong  nextTime       { s_never };
+    ulong  fetchTime      { s_never }; // cycle of pending sample fetch
+
+    bool isActive() const;
+
+    uchar output() const { return level; }
+
+    ulong period() const;
+  };
+
+ protected:
+  void sync();
+
+  void run(ulong time);
+  void runTo(ulong time);
+
+  void clockFrame(ulong time);
+  void clockQuarterFrame();
+  void clockHalfFrame();
+
+  void stepDMC(ulong time);
+  void fetchDMC();
+
+  void schedule(ulong time);
+
+  void updateOutput(ulong time);
+
+  ulong cpuCycles() const;
+
+ protected:
+  Machine*   machine_    { nullptr };
+  bool       debugWrite_ { false };
+
+  Pulse      pulse_[2];
+  Triangle   triangle_;
+  Noise      noise_;
+  DMC        dmc_;
+
+  // frame counter
+  bool       frameMode5_      { false };
+  bool       frameIRQInhibit_ { false };
+  bool       frameIRQ_        { false };
+  int        frameStep_       { 0 };
+  ulong      frameStart_      { 0 };       // cycle of frame sequence start
+  ulong      frameTime_       { s_never }; // cycle of next frame sequence step
+
+  ulong      numDMCFetches_   { 0 };
+
+  // output
+  ulong      time_            { 0 }; // cycle apu is caught up to
+  int        amp_             { 0 }; // last output amplitude
+  BlipBuffer blip_;
+};
+
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef CNES_AudioSink_H
+#define CNES_AudioSink_H
+
+#include <CNES_RingBuffer.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <string>
+#include <cstdio>
+
+namespace CNES {
+
+// Destination for APU samples (mono 16 bit)
+//
+// writeSamples is called from the emulation thread once per frame and must not block.
+class AudioSink {
+ public:
+  AudioSink(int sampleRate=44100) :
+   sampleRate_(sampleRate) {
+  }
+
+  virtual ~AudioSink() { }
+
+  int sampleRate() const { return sampleRate_; }
+
+  virtual void writeSamples(const short *samples, int n) = 0;
+
+  // fraction of buffer filled (0-1), negative if no buffer (no rate control)
+  virtual double fillLevel() const { return -1.0; }
+
+  // seconds of audio queued for output
+  virtual double latency() const { return 0.0; }
+
+  // max seconds of audio which can be queued (0 if unbounded)
+  virtual double maxLatency() const { return 0.0; }
+
+ protected:
+  int sampleRate_ { 44100 };
+};
+
+//---
+
+// Discards samples (headless benchmarking)
+class NullAudioSink : public AudioSink {
+ public:
+  NullAudioSink(int sampleRate=44100) :
+   AudioSink(sampleRate) {
+  }
+
+  void writeSamples(const short *, int n) override { numSamples_ += n; }
+
+  ulong numSamples() const { return numSamples_; }
+
+ private:
+  ulong numSamples_ { 0 };
+};
+
+//---
+
+// Writes samples to WAV file (offline rendering)
+//
+// Samples are collected into blocks which a writer thread saves, so file i/o
+// never stalls emulation.
+class WavAudioSink : public AudioSink {
+ public:
+  WavAudioSink(int sampleRate=44100);
+ ~WavAudioSink();
+
+  bool open(const std::string &filename);
+  void close();
+
+  void writeSamples(const short *samples, int n) override;
+
+  ulong numSamples() const { return numSamples_; }
+
+ private:
+  void writeThread();
+
+  void writeHeader();
+
+ private:
+  static const uint s_blockSize = 32768;
+
+  using Block  = std::vector<short>;
+  using Blocks = std::deque<Block>;
+
+  FILE*                   fp_         { nullptr };
+  Block                   block_;                   // block being filled
+  ulong                   numSamples_ { 0 };
+
+  // writer thread
+  std::thread             thread_;
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+  Blocks                  blocks_;                  // blocks to write
+  bool                    done_       { false };
+};
+
+//---
+
+// Lock-free queue of samples for an output thread
+//
+// Capacity is the max latency, dynamic rate control aims to keep it a quarter full.
+class RingAudioSink : public AudioSink {
+ public:
+  RingAudioSink(int sampleRate=44100, double maxLatency=0.040);
+
+  // emulation thread
+  void writeSamples(const short *samples, int n) override;
+
+  double fillLevel() const override;
+
+  double latency() const override;
+
+  double maxLatency() const override;
+
+  // output thread (pads with last sample on underrun)
+  int readSamples(short *samples, int n);
+
+  ulong numOverruns () const { return numOverruns_ .load(); }
+  ulong numUnderruns() const { return numUnderruns_.load(); }
+
+ private:
+  using Ring = RingBuffer<short>;
+
+  Ring               ring_;
+  uint               capacity_     { 0 }; // max queued samples
+  short              lastSample_   { 0 }; // output thread
+  std::atomic<ulong> numOverruns_  { 0 };
+  std::atomic<ulong> numUnderruns_ { 0 };
+};
+
+}
+
+#endif
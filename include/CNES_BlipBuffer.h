@@ -0,0 +1,64 @@
+#ifndef CNES_BlipBuffer_H
+#define CNES_BlipBuffer_H
+
+#include <CNES_Types.h>
+#include <vector>
+
+namespace CNES {
+
+// Band-limited step synthesis buffer
+//
+// Amplitude changes (deltas) are added at clock times as band-limited (windowed sinc)
+// impulses and integrated to samples on read, so output only needs computing when
+// the synthesized waveform changes rather than every clock.
+class BlipBuffer {
+ public:
+  BlipBuffer();
+
+  double clockRate() const { return clockRate_; }
+  int sampleRate() const { return sampleRate_; }
+
+  void setRates(double clockRate, int sampleRate);
+
+  // clock time of end of last frame
+  ulong frameTime() const { return frameTime_; }
+
+  void clear(ulong time);
+
+  // add amplitude change at clock time (must be >= frameTime)
+  void addDelta(ulong time, float delta);
+
+  // make samples up to clock time available
+  void endFrame(ulong time);
+
+  int samplesAvail() const { return avail_; }
+
+  // read (and remove) samples, null output discards
+  int readSamples(short *out, int n);
+
+ private:
+  void initKernel();
+
+ private:
+  static const int s_width  = 16; // kernel width (samples)
+  static const int s_phases = 32; // kernel sub-sample phases
+
+  using Buffer = std::vector<float>;
+
+  double clockRate_   { 1789773.0 };
+  int    sampleRate_  { 44100 };
+  double factor_      { 0.0 };   // samples per clock
+  float  kernel_[s_phases][s_width];
+  Buffer buffer_;                // deltas (index 0 is first unread sample)
+  ulong  frameTime_   { 0 };     // clock time of offset
+  double offset_      { 0.0 };   // sample position of frame time
+  int    avail_       { 0 };     // samples ready to read
+  float  integrator_  { 0.0f };  // running sum of deltas
+  float  highPassIn_  { 0.0f };  // dc blocker state
+  float  highPassOut_ { 0.0f };
+  float  highPassR_   { 0.995f };
+};
+
+}
+
+#endif
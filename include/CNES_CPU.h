@@ -2,6 +2,7 @@
 #define CNES_CPU_H
 
 #include <CNES_Types.h>
+#include <CNES_Trace.h>
 #include <C6502.h>
 
 namespace CNES {
@@ -21,6 +22,14 @@ class CPU : public C6502 {
 
   uchar ppuGetByte(ushort addr) const;
 
+  // read code byte without side effects or debug output (profiler/trace)
+  uchar opcodeByte(ushort addr) const;
+
+  // record bus trace event at current cycle and pc (echo prints it)
+  void trace(Trace::Kind kind, ushort addr, uchar value, bool echo=false) const {
+    trace_->add(cycles_, PC(), addr, value, kind, echo);
+  }
+
   uchar getByte(ushort addr) const override;
   void setByte(ushort addr, uchar c) override;
 
@@ -28,22 +37,63 @@ class CPU : public C6502 {
 
   void tick(uchar n) override;
 
+  // elapsed cpu cycles
+  ulong cycles() const { return cycles_; }
+
+  // cycles cpu was stalled by DMC sample fetches
+  ulong dmcStallCycles() const { return dmcStallCycles_; }
+
+  // refetch DMC fetch time from APU (after APU state change)
+  void updateDMCFetchTime();
+
+  // IRQ line (APU frame counter and DMC interrupts)
+  bool isIRQ() const { return irq_; }
+
+  // refetch IRQ line and frame interrupt time from APU (after APU state change)
+  void updateIRQ() const;
+
+  // take IRQ before next instruction if line asserted and interrupts enabled
+  void pollIRQ();
+
   bool isScreen(ushort pos, ushort len) const override;
 
+  // dumps trace if enabled (call from overrides)
+  void breakpointHit() override;
+
   //---
 
+  // I/O change notification (coalesced and sent by flushChanges)
   virtual void signalNesChanged() { }
 
+  void flushChanges();
+
+ private:
+  ulong dmcFetch();
+
  private:
   Machine*      machine_    { nullptr };
+  Trace*        trace_      { nullptr };
 
   // debug
   bool          debugRead_  { false };
   bool          debugWrite_ { false };
 
-  // keys
-  mutable uchar keyNum1_ { 0 };
-  mutable uchar keyNum2_ { 0 };
+  // I/O written since last flush
+  bool          nesChanged_ { false };
+
+  // elapsed cpu cycles
+  ulong         cycles_     { 0 };
+
+  // DMC DMA (fetches at cycle deadline, stall cycles charged in bulk)
+  ulong         dmcFetchTime_   { ~0UL };
+  ulong         dmcStallCycles_ { 0 };
+  bool          oamDMA_         { false };
+  mutable int   joyRead_        { -1 };   // joystick read by current instruction
+  ulong         joyReadTime_    { 0 };    // cycle of joystick read
+
+  // APU IRQ (level, frame interrupt raised at cached time)
+  mutable bool  irq_            { false };
+  mutable ulong irqTime_        { 0 };    // 0 so first tick fetches it
 
   mutable bool in_ppu_ { false };
 };
@@ -0,0 +1,14 @@
+#ifndef CNES_CRC_H
+#define CNES_CRC_H
+
+#include <CNES_Types.h>
+#include <cstddef>
+
+namespace CNES {
+
+// CRC-32 (as used by PNG and ROM databases), pass previous crc to continue
+uint crc32(const uchar *data, size_t len, uint crc=0);
+
+}
+
+#endif
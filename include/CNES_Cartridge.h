@@ -23,6 +23,41 @@ class Cartridge {
 
   bool load(const std::string &filename);
 
+  // load NES (iNES) file contents from memory
+  bool loadNESData(const std::vector<uchar> &data);
+
+  //---
+
+  // NES Sound Format (NSF) data
+  struct NSFData {
+    std::string name;
+    std::string artist;
+    std::string copyright;
+    uchar       numSongs     { 1 };
+    uchar       startSong    { 1 };
+    ushort      loadAddr     { 0x8000 };
+    ushort      initAddr     { 0x8000 };
+    ushort      playAddr     { 0x8000 };
+    ushort      speed        { 16639 }; // play period (usecs)
+    bool        pal          { false };
+    uchar       extraChips   { 0 };
+    bool        bankSwitched { false };
+    uchar       banks[8]     { };       // initial 4K banks at $8000-$FFFF
+  };
+
+  bool isNSF() const { return isNSF_; }
+
+  const NSFData &nsfData() const { return nsfData_; }
+
+  void initNSF(int song=0);
+
+  void setNSFBank(int i, uchar bank);
+
+  //---
+
+  // CRC32 of ROM data (for per ROM settings)
+  uint crc() const { return crc_; }
+
   ushort prgSize() const { return prgSize_; }
   ushort chrSize() const { return chrSize_; }
 
@@ -33,22 +68,30 @@ class Cartridge {
   ushort prgRamSize() const { return prgRamSize_; }
 
   int chrLPage() const { return chrLPage_; }
-  void setChrLPage(int i) { chrLPage_ = i; }
+  void setChrLPage(int i) { chrLPage_ = i; chrChanged(); }
 
   int chrHPage() const { return chrHPage_; }
-  void setChrHPage(int i) { chrHPage_ = i; }
+  void setChrHPage(int i) { chrHPage_ = i; chrChanged(); }
+
+  // incremented when CHR data or CHR bank mapping changes
+  ulong chrVersion() const { return chrVersion_; }
 
   bool getLowerROMByte(ushort addr, uchar &c) const;
   bool getUpperROMByte(ushort addr, uchar &c) const;
 
   bool setROMByte(ushort addr, uchar c);
 
+  // PRG ROM bank mapped at cpu address (16K banks, 4K for NSF), -1 if not ROM
+  int prgBank(ushort addr) const;
+
   bool getVRAMByte(ushort addr, uchar &c) const;
 
   virtual void updateState() { }
 
   int numTiles() const;
 
+  void getTilePixels(int it, uchar *pixels, int stride) const;
+
   void drawTiles();
   void drawTile(int it);
   void drawTileChar(int it, int ic, int x, int y);
@@ -64,6 +107,15 @@ class Cartridge {
 
  protected:
   bool loadNES(const std::string &filename);
+  bool loadNSF(const std::string &filename);
+
+  static bool readFile(const std::string &filename, std::vector<uchar> &data);
+
+  uchar getNSFByte(ushort addr) const;
+
+  void updateMirroring();
+
+  void chrChanged() { ++chrVersion_; }
 
  protected:
   using Data = std::vector<uchar>;
@@ -102,6 +154,12 @@ class Cartridge {
 
   Data trainerData_;
 
+  // NSF
+  bool    isNSF_       { false };
+  NSFData nsfData_;
+  Data    nsfRomData_;
+  uchar   nsfBanks_[8] { };
+
   Data playChoiceData_;
   Data playExtraData_;
 
@@ -114,6 +172,7 @@ class Cartridge {
     uchar regValue { 0 };
 
     uchar mirror    { 0 };
+    bool  mirrorSet { false }; // mirror written (header mirroring until then)
 
     uchar romBank   { 1 };
     uchar romSize   { 0 };
@@ -153,6 +212,10 @@ class Cartridge {
   int chrLPage_ { -1 };
   int chrHPage_ { -1 };
 
+  ulong chrVersion_ { 0 };
+
+  uint crc_ { 0 };
+
   mutable int currentTile_;
 };
 
@@ -0,0 +1,48 @@
+#ifndef CNES_DirtyMap_H
+#define CNES_DirtyMap_H
+
+#include <CNES_Types.h>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+namespace CNES {
+
+// Bitmap of changed addresses, reported as coalesced ranges
+class DirtyMap {
+ public:
+  using RangeProc = std::function<void(ushort addr, ushort len)>;
+
+ public:
+  DirtyMap(uint size);
+
+  uint size() const { return size_; }
+
+  bool isDirty() const { return dirty_; }
+
+  void set(uint addr) {
+    addr &= (size_ - 1);
+
+    bits_[addr >> 6] |= (uint64_t(1) << (addr & 63));
+
+    dirty_ = true;
+  }
+
+  void set(uint addr, uint len);
+
+  void clear();
+
+  // call proc for each contiguous dirty range then clear
+  void processRanges(const RangeProc &proc);
+
+ private:
+  using Bits = std::vector<uint64_t>;
+
+  uint size_  { 0 };     // power of two
+  Bits bits_;
+  bool dirty_ { false };
+};
+
+}
+
+#endif
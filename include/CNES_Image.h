@@ -0,0 +1,52 @@
+#ifndef CNES_Image_H
+#define CNES_Image_H
+
+#include <CNES_Types.h>
+#include <string>
+#include <vector>
+
+namespace CNES {
+
+// RGB image (8 bits per component) for headless screen capture
+class Image {
+ public:
+  Image(int width=0, int height=0);
+
+  int width () const { return width_ ; }
+  int height() const { return height_; }
+
+  void getPixel(int x, int y, uchar &r, uchar &g, uchar &b) const {
+    const uchar *p = &data_[(y*width_ + x)*3];
+
+    r = p[0]; g = p[1]; b = p[2];
+  }
+
+  void setPixel(int x, int y, uchar r, uchar g, uchar b) {
+    uchar *p = &data_[(y*width_ + x)*3];
+
+    p[0] = r; p[1] = g; p[2] = b;
+  }
+
+  // set from PPU screen pixels (emphasis << 8 | palette index)
+  void setScreenPixels(const ushort *pixels);
+
+  // set from RGBA8888 pixels (stride in bytes)
+  void setRGBAPixels(const uchar *data, int stride);
+
+  // write as PNG (uncompressed deflate so no zlib dependency)
+  bool writePNG(const std::string &filename) const;
+
+  // RGB of NES palette index (0-63)
+  static void paletteRGB(uchar c, uchar &r, uchar &g, uchar &b);
+
+ private:
+  using Data = std::vector<uchar>;
+
+  int  width_  { 0 };
+  int  height_ { 0 };
+  Data data_;
+};
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef CNES_Input_H
+#define CNES_Input_H
+
+#include <CNES_Types.h>
+#include <atomic>
+
+namespace CNES {
+
+// Standard controllers on $4016/$4017
+//
+// Button state is published (from any thread) as one atomic byte per controller
+// and sampled into the controller shift register when the strobe is released
+// ($4016 <- 0). Reads then shift out A, B, Select, Start, Up, Down, Left, Right
+// followed by 1s.
+class Input {
+ public:
+  enum Button : uchar {
+    BUTTON_A      = 0x01,
+    BUTTON_B      = 0x02,
+    BUTTON_SELECT = 0x04,
+    BUTTON_START  = 0x08,
+    BUTTON_UP     = 0x10,
+    BUTTON_DOWN   = 0x20,
+    BUTTON_LEFT   = 0x40,
+    BUTTON_RIGHT  = 0x80
+  };
+
+  static const int s_numControllers = 2;
+
+ public:
+  Input();
+
+  // button state (any thread)
+  uchar buttons(int i) const {
+    return buttons_[i & 1].load(std::memory_order_relaxed);
+  }
+
+  void setButtons(int i, uchar b) {
+    buttons_[i & 1].store(b, std::memory_order_relaxed);
+  }
+
+  void setButton(int i, Button b, bool pressed) {
+    if (pressed)
+      buttons_[i & 1].fetch_or (uchar( b), std::memory_order_relaxed);
+    else
+      buttons_[i & 1].fetch_and(uchar(~b), std::memory_order_relaxed);
+  }
+
+  // controller port access (emulation thread)
+  void setStrobe(uchar c);
+
+  uchar read(int i);
+
+  uchar peek(int i) const;
+
+ private:
+  std::atomic<uchar> buttons_[s_numControllers];
+  bool               strobe_ { false };
+  uchar              shift_[s_numControllers];
+};
+
+}
+
+#endif
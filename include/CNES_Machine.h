@@ -2,11 +2,22 @@
 #define CNES_Machine_H
 
 #include <CNES_Types.h>
+#include <CNES_PPU.h>
+#include <CNES_Input.h>
+#include <CNES_Pacer.h>
+#include <CNES_SoundLog.h>
+#include <CNES_Stats.h>
+#include <CNES_Profiler.h>
+#include <CNES_Trace.h>
+#include <map>
+#include <vector>
 
 namespace CNES {
 
 class CPU;
 class PPU;
+class APU;
+class AudioSink;
 class Cartridge;
 
 class Machine {
@@ -20,6 +31,7 @@ class Machine {
   CPU       *getCPU () const { return cpu_ ; }
   PPU       *getPPU () const { return ppu_ ; }
   Cartridge *getCart() const { return cart_; }
+  APU       *getAPU () const { return apu_ ; }
 
   bool isDebugRead() const { return debugRead_; }
   void setDebugRead(bool b) { debugRead_ = b; }
@@ -27,19 +39,90 @@ class Machine {
   bool isDebugWrite() const { return debugWrite_; }
   void setDebugWrite(bool b) { debugWrite_ = b; }
 
+  Input &input() { return input_; }
+
+  Pacer &pacer() { return pacer_; }
+
+  // run cpu (drawing lines as they complete) until frame done, then pace
+  bool runFrame();
+
+  // send coalesced change notifications (once per frame or on debugger refresh)
+  void flushChanges();
+
+  // audio output (sink not owned)
+  AudioSink *audioSink() const { return audioSink_; }
+  void setAudioSink(AudioSink *sink);
+
+  // sound register log (VGM file)
+  SoundLog &soundLog() { return soundLog_; }
+
+  bool startSoundLog(const std::string &filename);
+  void stopSoundLog();
+
+  // instrumentation (only updated when built with CNES_STATS)
+  Stats &stats() { return stats_; }
+
+  // binary bus trace ring
+  Trace &trace() { return trace_; }
+
+  // guest code sampling profiler
+  Profiler &profiler() { return profiler_; }
+
+  // called (cpu time) when ppu completes a frame
+  void frameDone();
+
+  //---
+
+  // ppu render mode used for loaded ROMs (unless overridden for ROM)
+  PPU::RenderMode defaultRenderMode() const { return defaultRenderMode_; }
+  void setDefaultRenderMode(PPU::RenderMode mode) { defaultRenderMode_ = mode; }
+
+  // per ROM (cartridge CRC32) render mode overrides, file has one
+  // "<crc32 hex> <scanline|dot> [comment]" per line
+  bool loadRenderOverrides(const std::string &filename);
+
+  void setRenderOverride(uint crc, PPU::RenderMode mode) { renderOverrides_[crc] = mode; }
+
+  // called when cartridge loaded (applies render mode)
+  void cartridgeLoaded();
+
  protected:
   void initMemory();
 
   void tick(ushort n);
 
+  void updateAudio();
+
  protected:
   friend class CPU;
 
   CPU*       cpu_        { nullptr };
   PPU*       ppu_        { nullptr };
   Cartridge* cart_       { nullptr };
+  APU*       apu_        { nullptr };
   bool       debugRead_  { false };
   bool       debugWrite_ { false };
+  Input      input_;
+  Pacer      pacer_;
+  SoundLog   soundLog_;
+  Stats      stats_;
+  Trace      trace_;
+  Profiler   profiler_ { this };
+
+  // render mode
+  using RenderOverrides = std::map<uint, PPU::RenderMode>;
+
+  PPU::RenderMode defaultRenderMode_ { PPU::RenderMode::SCANLINE };
+  RenderOverrides renderOverrides_;
+
+  // audio
+  using Samples = std::vector<short>;
+
+  AudioSink* audioSink_       { nullptr };
+  Samples    audioSamples_;
+  double     audioRateDelta_  { 0.005 }; // max dynamic rate control adjustment
+  double     audioFillTarget_ { 0.25 };  // sink fill level (at frame start) to aim for
+  double     audioFill_       { -1.0 };  // sink fill level at frame start
 };
 
 }
@@ -0,0 +1,107 @@
+#ifndef CNES_NTSC_H
+#define CNES_NTSC_H
+
+#include <CNES_Palette.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CNES {
+
+// NTSC composite video filter.
+//
+// PPU screen pixels (emphasis << 8 | palette index) are encoded as the composite
+// signal the PPU outputs (8 samples per pixel, 12 samples per color cycle, line
+// phase advanced by 4 samples per line) and decoded to YIQ with box filters
+// (12 samples luma, 24 samples chroma) giving color fringing and dot crawl.
+// Output is 7 pixels per 3 input pixels (602 wide for 256) in a 32 or 16 bit
+// frame buffer format. Lines are split across worker threads.
+class NTSCFilter {
+ public:
+  NTSCFilter(int numThreads=0); // 0 for cpu count (max 4)
+
+ ~NTSCFilter();
+
+  NTSCFilter(const NTSCFilter &) = delete;
+  NTSCFilter &operator=(const NTSCFilter &) = delete;
+
+  static int outputWidth(int width) { return ((width - 1)/3 + 1)*7; }
+
+  // threads used by filter (including caller)
+  int numThreads() const { return numThreads_; }
+  void setNumThreads(int n);
+
+  // hue offset (color cycle samples), saturation and brightness gain
+  float hue() const { return hue_; }
+  void setHue(float r) { hue_ = r; initTables(); }
+
+  float saturation() const { return saturation_; }
+  void setSaturation(float r) { saturation_ = r; initTables(); }
+
+  float brightness() const { return brightness_; }
+  void setBrightness(float r) { brightness_ = r; initTables(); }
+
+  // filter w x h pixels (source stride in pixels) to outputWidth(w) x h pixels
+  // (dest stride in bytes). Frame number selects color burst phase (dot crawl).
+  // Returns false for unsupported (INDEXED8) format
+  bool filter(const ushort *pixels, int w, int h, int pixelStride, ulong frameNum,
+              Palette::Format format, uchar *dest, int destStride);
+
+ private:
+  struct Job {
+    const ushort*   pixels      { nullptr };
+    int             w           { 0 };
+    int             h           { 0 };
+    int             pixelStride { 0 };
+    int             phase       { 0 };
+    Palette::Format format      { Palette::Format::RGBA8888 };
+    uchar*          dest        { nullptr };
+    int             destStride  { 0 };
+  };
+
+  void initTables();
+
+  void startThreads(int n);
+  void stopThreads();
+
+  void workerThread(int ithread, ulong jobNum);
+
+  void filterLines(const Job &job, int y1, int y2) const;
+
+ private:
+  using Samples = std::vector<float>;
+  using Threads = std::vector<std::thread>;
+
+  static const int s_samplesPerPixel { 8 };
+  static const int s_colorCycle      { 12 };
+
+  static const int s_sumsPerPixel    { s_samplesPerPixel + 1 };
+
+  // partial sums (of first 0 to 8 samples) of signal, signal*cos and signal*sin
+  // (decode demodulation) of each pixel (emphasis*64 + palette index) for each pixel
+  // start phase (0, 4, 8). Separate arrays (as are filterLines arrays) so loops vectorize
+  Samples signalY_;
+  Samples signalI_;
+  Samples signalQ_;
+
+  // defaults fitted to Palette colors
+  float hue_        { 4.0f };
+  float saturation_ { 0.8f };
+  float brightness_ { 0.89f };
+
+  // worker threads (caller filters first block of lines)
+  Threads                 workers_;
+  int                     numThreads_ { 1 };
+  std::mutex              mutex_;
+  std::condition_variable startCond_;
+  std::condition_variable doneCond_;
+  Job                     job_;
+  ulong                   jobNum_   { 0 };
+  int                     numDone_  { 0 };
+  bool                    stopping_ { false };
+};
+
+}
+
+#endif
@@ -2,13 +2,32 @@
 #define CNES_PPU_H
 
 #include <CNES_Types.h>
+#include <CNES_DirtyMap.h>
+#include <string>
 #include <vector>
+#include <algorithm>
 
 namespace CNES {
 
 class Machine;
 
 class PPU {
+ public:
+  // name table mirroring (maps the four 1K name table slots to VRAM pages)
+  enum class Mirroring {
+    HORIZONTAL,  // $2000=$2400, $2800=$2C00
+    VERTICAL,    // $2000=$2800, $2400=$2C00
+    SINGLE_A,    // all slots use lower page
+    SINGLE_B,    // all slots use upper page
+    FOUR_SCREEN  // four pages (cartridge supplied VRAM)
+  };
+
+  // rendering backend (share register and VRAM state)
+  enum class RenderMode {
+    SCANLINE, // fast per line renderer (drawLine)
+    DOT       // dot accurate renderer (341 dots per line stepped in cpu time)
+  };
+
  public:
   PPU(Machine *machine);
 
@@ -30,14 +49,109 @@ class PPU {
 
   void copySpriteMem(uchar c);
 
+  // change notifications (coalesced and sent by flushChanges)
   virtual void memChanged(ushort /*addr*/, ushort /*len*/) { }
 
   virtual void spritesChanged() { }
 
+  void flushChanges();
+
   //---
 
   void tick(uchar n);
 
+  // render mode (change applied at next frame boundary unless immediate)
+  RenderMode renderMode() const { return renderMode_; }
+  void setRenderMode(RenderMode mode, bool immediate=false);
+
+  static const char *renderModeName(RenderMode mode);
+  static bool nameToRenderMode(const std::string &name, RenderMode &mode);
+
+  // frames completed (cpu time)
+  ulong frameNum() const { return frameNum_; }
+
+  static int cpuSpeed() { return s_cpuSpeed; }
+
+  // first visible scan line and number of visible lines (for drawLine)
+  static int topMargin   () { return s_topMargin; }
+  static int visibleLines() { return s_visibleLines; }
+  static int visiblePixels() { return s_visiblePixels; }
+
+  // lines per frame and dots per line
+  static int numLines () { return s_numLines; }
+  static int numPixels() { return s_numPixels; }
+
+  // screen pixels (visibleLines rows of visiblePixels, emphasis << 8 | palette index)
+  const ushort *screenPixels() const { return &screenPixels_[0]; }
+
+  // screen region (pixel bounds, x2 and y2 exclusive)
+  struct DamageRect {
+    int x1 { 0 };
+    int y1 { 0 };
+    int x2 { 0 };
+    int y2 { 0 };
+
+    bool isEmpty() const { return (x1 >= x2 || y1 >= y2); }
+
+    void add(int x1_, int y1_, int x2_, int y2_) {
+      if (isEmpty()) {
+        x1 = x1_; y1 = y1_; x2 = x2_; y2 = y2_;
+      }
+      else {
+        x1 = std::min(x1, x1_); y1 = std::min(y1, y1_);
+        x2 = std::max(x2, x2_); y2 = std::max(y2, y2_);
+      }
+    }
+
+    void reset() { x1 = 0; y1 = 0; x2 = 0; y2 = 0; }
+  };
+
+  // screen pixels changed since last clearDamage (dirty lines with changed x range
+  // and bounding rect) for frontends which only process changed regions
+  bool isLineDirty(int y) const { return lineDamageX1_[y] < lineDamageX2_[y]; }
+
+  bool lineDamage(int y, int &x1, int &x2) const {
+    x1 = lineDamageX1_[y];
+    x2 = lineDamageX2_[y];
+
+    return (x1 < x2);
+  }
+
+  const DamageRect &damage() const { return damage_; }
+
+  void clearDamage();
+
+  // screen pixels changed in current frame and in last completed frame
+  const DamageRect &frameDamage() const { return frameDamage_; }
+  const DamageRect &lastFrameDamage() const { return lastFrameDamage_; }
+
+  // called when screen pixels x1 to x2 (exclusive) of line y change
+  virtual void lineChanged(int /*y*/, int /*x1*/, int /*x2*/) { }
+
+  // fast (non-cryptographic) hash of screen pixels
+  ulong screenHash() const;
+
+  // lines waiting to be drawn (cpu time ahead of draw)
+  int numDrawLines() const { return numDrawLines_; }
+
+  // current draw line
+  int lineNum() const { return lineNum_; }
+
+  void drawPendingLines();
+
+  // video rendering (disable for headless audio rendering, keeps frame timing)
+  bool isVideoEnabled() const { return videoEnabled_; }
+  void setVideoEnabled(bool b) { videoEnabled_ = b; }
+
+  // frame skip (draw one frame in n + 1, for fast forward). Skipped frames only
+  // update sprite 0 hit and sprite overflow status (scanline render mode)
+  int frameSkip() const { return frameSkip_; }
+  void setFrameSkip(int n) { frameSkip_ = (n > 0 ? n : 0); skipCount_ = 0; }
+
+  bool isSkipFrame() const { return skipFrame_; }
+
+  virtual void linesDrawn() { }
+
   //---
 
   // screen
@@ -49,6 +163,12 @@ class PPU {
   uchar nameTable() const { return nameTable_; }
   ushort nameTableAddr() const { return nameTableAddr_; }
 
+  Mirroring mirroring() const { return mirroring_; }
+  void setMirroring(Mirroring mirroring);
+
+  // memory of name table slot (0-3) after mirroring
+  const uchar *nameTablePage(int i) const { return nameTablePage_[i & 3]; }
+
   // sprites
   ushort spritePatternAddr() const { return spritePatternAddr_; }
   ushort spritePatternAltAddr() const { return spritePatternAltAddr_; }
@@ -77,16 +197,27 @@ class PPU {
   bool isEmphasizeGreen() const { return emphasizeGreen_; }
   bool isEmphasizeBlue () const { return emphasizeBlue_; }
 
+  uchar emphasisBits() const;
+
   // mask
   bool isSpriteMasked() const { return spriteMask_; }
   bool isImageMasked() const { return imageMask_; }
 
   //---
 
-  uchar scrollH() const { return scrollHV_[0]; }
-  uchar scrollV() const { return scrollHV_[1]; }
+  // scroll (derived from temporary VRAM address and fine x)
+  uchar scrollH() const { return uchar(((t_ & 0x001F) << 3) | fineX_); }
+  uchar scrollV() const { return uchar(((t_ & 0x03E0) >> 2) | ((t_ & 0x7000) >> 12)); }
+
+  void resetScroll() { t_ &= 0x0C00; fineX_ = 0; }
 
-  void resetScroll() { scrollHV_[0] = 0; scrollHV_[1] = 0; }
+  // internal VRAM address registers (loopy v, t, x, w)
+  ushort vramAddr() const { return v_; }
+  ushort tempVRAMAddr() const { return t_; }
+  uchar fineX() const { return fineX_; }
+  bool writeToggle() const { return w_; }
+
+  bool isRendering() const { return screenVisible_ || spritesVisible_; }
 
   //---
 
@@ -96,14 +227,13 @@ class PPU {
   bool isSpriteHit() const { return spriteHit_; }
   void setSpriteHit(bool b) { spriteHit_ = b; }
 
-  virtual bool isKey1(int /*n*/) { return false; }
-  virtual bool isKey2(int /*n*/) { return false; }
-
   void drawLines();
   void drawLine(int y);
 
   void drawCharLine(int x, int y, uchar c, uchar ac, uchar iby, uchar ix1, uchar ix2);
 
+  const uchar *charLineSpan(uchar c, uchar ac, uchar iby);
+
   //---
 
   struct SpriteData {
@@ -125,6 +255,18 @@ class PPU {
 
   void drawSpriteAt(int i, int x, int y, int o);
 
+  // status flags of line without drawing (skipped frame or video disabled)
+  void skipLine(int y);
+
+  // sprite 0 hit (resolved on PPUSTATUS read)
+  void resolveSpriteHit();
+
+  int spriteHitX(int y);
+
+  // opaque (non-zero pattern) pixels (bit 7 leftmost) of sprite line and of background at x
+  uchar spriteLineOpaqueMask(const SpriteData &spriteData, int iby) const;
+  uchar backgroundOpaqueMask(int y, int x) const;
+
   //---
 
   uchar calcNameTableTile (int iy, int ix) const;
@@ -135,14 +277,38 @@ class PPU {
 
   void getSpriteData(int spriteNum, SpriteData &spriteData) const;
 
+  // pattern address of line (iby) of sprite
+  ushort spritePatternLineAddr(const SpriteData &spriteData, int iby) const;
+
   void drawLinePixel       (int x, int y, uchar color);
   void drawColorPixel      (int x, int y, uchar color);
   void drawCustomColorPixel(int x, int y, uchar color);
 
+  // custom (sprite preview) drawing, screen changes are reported by lineChanged
   virtual void setColor(uchar /*c*/) { }
   virtual void drawPixel(int /*x*/, int /*y*/) { }
 
-//bool isSprite0Hit(int y) const;
+ protected:
+  void nextLine();
+
+  // write composed line pixels to screen (compares whole line, updates damage)
+  void outputLine(int y);
+
+  void addDamage(int y, int x1, int x2);
+
+  void updateScroll(int dot1, int dot2);
+
+  void incrementScrollX();
+  void incrementScrollY();
+
+  static ushort incrementedScrollY(ushort v);
+
+  // dot renderer
+  void tickDots(int n);
+  void stepDot();
+  void loadBackgroundShifters();
+  void evaluateDotSprites(int y);
+  void drawDotPixel(int x, int y);
 
  protected:
   using SPixels = std::vector<ushort>;
@@ -161,14 +327,16 @@ class PPU {
   static const int s_numPixels     { 341 };
   static const int s_vblankLine    { s_topMargin + s_visibleLines };
 
-  static const int s_cpuSpeed     { 1'790'000 };
-  static const int s_displaySpeed { 60 };
-  static const int s_ticksPerLine { s_cpuSpeed/(s_displaySpeed*s_numLines) };
+  static const int s_cpuSpeed     { 1'789'773 }; // NTSC
+  static const int s_displaySpeed { 60 };        // NTSC: 60.0988 (cpu speed/cycles per frame)
+  static const int s_dotsPerTick  { 3 };         // ppu dots per cpu cycle
 
   static const int s_leftMargin  = (s_numPixels - s_visiblePixels)/2;
   static const int s_rightMargin = s_numPixels - s_visiblePixels - s_leftMargin;
   static const int s_rightPixel  = s_leftMargin + s_visiblePixels;
 
+  static const int s_spanCacheSize { 1024 }; // char line span cache entries (power of 2)
+
   //---
 
   Machine* machine_ { nullptr };
@@ -194,22 +362,32 @@ class PPU {
   mutable uchar  spriteAddr_           { 0 };
   uchar          spriteMem_[256];      // TODO: typically located at $0200-$02FF
 
+  // changes since last flush
+  DirtyMap       memDirty_             { 0x4000 };
+  DirtyMap       spritesDirty_         { 0x100 };
+
   // name table
   uchar          nameTable_            { 0x00 };
   ushort         nameTableAddr_        { 0x0000 };
-
-  // ppu memory (PPUADDR)
-  mutable ushort ppuAddr_              { 0x0000 };
+  Mirroring      mirroring_            { Mirroring::HORIZONTAL };
+  uchar*         nameTablePage_[4];    // name table slot memory ($2000, $2400, $2800, $2C00)
+
+  // internal VRAM address registers shared by PPUSCROLL and PPUADDR
+  //  v : current VRAM address (yyy NN YYYYY XXXXX fine y, name table, coarse y, coarse x)
+  //  t : temporary VRAM address (top left of screen)
+  //  x : fine x scroll
+  //  w : first/second write toggle
+  mutable ushort v_                    { 0x0000 };
+  ushort         t_                    { 0x0000 };
+  uchar          fineX_                { 0 };
+  mutable bool   w_                    { false };
   mutable uchar  ppuBuffer_            { 0x00 };
   uchar          ppuVal_               { 0x00 };
-  uchar          ppuAddrHL_[2];
   bool           verticalWrite_        { false }; // for ppu addr increment
 
-  // scroll (PPUSCROLL)
-  uchar          scrollHV_[2];                 // scroll h/v values
-  uchar          scrollV_              { 0 };  // copy of scroll v for draw lines
-
-  mutable uchar  byteId_               { 0 }; // byte id for PPUSCROLL and PPUADDR
+  // scroll state (v and fine x) at start of each visible line (cpu time)
+  ushort         lineV_    [s_visibleLines] { };
+  uchar          lineFineX_[s_visibleLines] { };
 
   // interrupts
   bool           spriteInterrupt_      { false };
@@ -232,15 +410,76 @@ class PPU {
   int      pixelLineNum_    { 0 };     // pixel line number (0 - 240)
   bool     vblank_          { false };
   bool     spriteHit_       { false };
+  int      hitLine_         { -1 };    // pixel line of sprite 0 hit in frame (-1 none)
+  int      hitDot_          { 0 };     // dot of sprite 0 hit on line
+  int      hitNextLine_     { 0 };     // next pixel line to test for sprite 0 hit
   bool     spritesOverflow_ { false };
   bool     in_ppu_          { false };
+  bool     videoEnabled_    { true };
+  int      frameSkip_       { 0 };     // frames skipped per drawn frame
+  int      skipCount_       { 0 };     // frames skipped since last drawn
+  bool     skipFrame_       { false }; // current frame skipped
   uchar    color0_          { 0 };
   SPixels  screenPixels_;
   Pixels   linePixels_;
+  uchar    leftDrawn_       { 0xFF };  // line pixels 0-7 drawn (bit per pixel, unset keep screen)
+
+  // screen damage (changed x range per line, bounding rects)
+  short      lineDamageX1_[s_visibleLines] { };
+  short      lineDamageX2_[s_visibleLines] { };
+  DamageRect damage_;
+  DamageRect frameDamage_;
+  DamageRect lastFrameDamage_;
 
   // draw timing
-  int      lineTicks_       { s_ticksPerLine }; // ticks to wait before drawing a line
-  int      numDrawLines_    { 0 };              // lines to draw on next paint
+  int      lineDots_        { 0 };  // dots elapsed on current (cpu time) line
+  int      tickLine_        { 0 };  // current (cpu time) line
+  ulong    frameNum_        { 0 };  // frames completed (cpu time)
+  int      numDrawLines_    { 0 };  // lines to draw on next paint
+  int      lineNum_         { 0 };  // next line to draw
+
+  //---
+
+  // char line span cache (8 colors per entry, key includes generation)
+  struct SpanEntry {
+    ulong key { 0 };
+    uchar pixels[8];
+  };
+
+  using SpanCache = std::vector<SpanEntry>;
+
+  SpanCache spanCache_;
+  ulong     spanGeneration_ { 1 };
+  ulong     spanChrVersion_ { 0 };
+
+  //---
+
+  // render mode
+  RenderMode renderMode_        { RenderMode::SCANLINE };
+  RenderMode pendingRenderMode_ { RenderMode::SCANLINE };
+
+  // dot renderer background pipeline (fetch latches and 16 bit shifters)
+  uchar    dotTile_         { 0 };
+  uchar    dotAttr_         { 0 };
+  uchar    dotPatternLo_    { 0 };
+  uchar    dotPatternHi_    { 0 };
+  ushort   bgShiftLo_       { 0 };
+  ushort   bgShiftHi_       { 0 };
+  ushort   attrShiftLo_     { 0 };
+  ushort   attrShiftHi_     { 0 };
+
+  // dot renderer sprites on line (max 8, patterns pre-flipped)
+  struct DotSprite {
+    uchar patternLo { 0 };
+    uchar patternHi { 0 };
+    uchar color     { 0 };
+    bool  behind    { false };
+    bool  zero      { false };
+    int   x         { 0 };
+  };
+
+  DotSprite dotSprites_[8];
+  int       numDotSprites_ { 0 };
 };
 
 }
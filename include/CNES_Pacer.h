@@ -0,0 +1,98 @@
+#ifndef CNES_Pacer_H
+#define CNES_Pacer_H
+
+#include <CNES_Types.h>
+#include <chrono>
+#include <functional>
+
+namespace CNES {
+
+// Frame pacing and speed control
+//
+// Called once per emulated frame (endFrame) to wait until the frame is due:
+//  . REAL_TIME    : locked to monotonic clock at frame rate (absolute deadlines, no drift)
+//  . AUDIO        : wait while queued audio exceeds target latency (set from
+//                   audio sink capacity by Machine::setAudioSink)
+//  . FAST_FORWARD : real time scaled by speed
+//  . UNTHROTTLED  : no waiting
+class Pacer {
+ public:
+  enum class Mode {
+    REAL_TIME,
+    AUDIO,
+    FAST_FORWARD,
+    UNTHROTTLED
+  };
+
+  // frame interval statistics (seconds)
+  struct Stats {
+    long   frames  { 0 };
+    double mean    { 0.0 };
+    double m2      { 0.0 }; // sum of squared differences from mean
+    double minTime { 0.0 };
+    double maxTime { 0.0 };
+    double maxDev  { 0.0 }; // max deviation from target interval
+    long   resyncs { 0 };   // deadline resets (fell too far behind)
+
+    double variance() const { return (frames > 1 ? m2/(frames - 1) : 0.0); }
+    double jitter  () const;
+  };
+
+  // returns seconds of audio queued for output
+  using AudioQueued = std::function<double()>;
+
+  // NTSC: 1789773 / (262 * 341 / 3)
+  static constexpr double s_ntscFrameRate = 60.0988;
+
+ public:
+  Pacer();
+
+  Mode mode() const { return mode_; }
+  void setMode(Mode mode);
+
+  int speed() const { return speed_; }
+  void setSpeed(int speed);
+
+  double frameRate() const { return frameRate_; }
+  void setFrameRate(double r);
+
+  const AudioQueued &audioQueued() const { return audioQueued_; }
+  void setAudioQueued(const AudioQueued &f) { audioQueued_ = f; }
+
+  double audioLatency() const { return audioLatency_; }
+  void setAudioLatency(double t) { audioLatency_ = t; }
+
+  // target frame interval for current mode (0 if unthrottled)
+  double frameTime() const;
+
+  void reset();
+
+  void endFrame();
+
+  const Stats &stats() const { return stats_; }
+  void resetStats();
+
+ private:
+  using Clock     = std::chrono::steady_clock;
+  using TimePoint = Clock::time_point;
+  using Duration  = std::chrono::duration<double>;
+
+  void waitUntil(const TimePoint &t) const;
+
+  void updateStats(const TimePoint &t);
+
+ private:
+  Mode        mode_         { Mode::REAL_TIME };
+  int         speed_        { 1 };
+  double      frameRate_    { s_ntscFrameRate };
+  AudioQueued audioQueued_;
+  double      audioLatency_ { 0.040 };
+  bool        started_      { false };
+  TimePoint   deadline_;  // time next frame is due
+  TimePoint   lastTime_;  // time last frame ended
+  Stats       stats_;
+};
+
+}
+
+#endif
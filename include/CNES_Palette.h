@@ -0,0 +1,43 @@
+#ifndef CNES_Palette_H
+#define CNES_Palette_H
+
+#include <CNES_Types.h>
+
+namespace CNES {
+
+// conversion of PPU screen pixels (emphasis << 8 | palette index) to frame buffer
+// formats using a 512 entry (8 emphasis x 64 colors) lookup table. Output is
+// written directly into caller supplied buffers (with byte stride per line)
+class Palette {
+ public:
+  enum class Format {
+    RGBA8888, // bytes R, G, B, A
+    BGRA8888, // bytes B, G, R, A (QImage::Format_ARGB32 on little endian)
+    RGB565,   // 16 bit 5:6:5 (native endian)
+    INDEXED8  // palette index (0-63) with colors from colorTable (per emphasis)
+  };
+
+ public:
+  // RGB of screen pixel (emphasis bits 8-10, palette index bits 0-5)
+  static void rgb(ushort pixel, uchar &r, uchar &g, uchar &b);
+
+  static int bytesPerPixel(Format format);
+
+  // convert w x h pixels (source stride in pixels, dest stride in bytes)
+  static void convert(const ushort *pixels, int w, int h, int pixelStride,
+                      Format format, uchar *dest, int destStride);
+
+  // convert n pixels of line
+  static void convertLine(const ushort *pixels, int n, Format format, uchar *dest);
+
+  // 64 colors of emphasis (0-7) in format (RGBA8888 for INDEXED8) for indexed output
+  static void colorTable(uchar emphasis, Format format, uchar *dest);
+
+  // vectorized conversion (AVX2 gather when supported by cpu, else scalar)
+  static bool isSIMD();
+  static void setSIMD(bool b);
+};
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef CNES_Profiler_H
+#define CNES_Profiler_H
+
+#include <CNES_Types.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+namespace CNES {
+
+class Machine;
+
+// Sampling profiler for guest 6502 code
+//
+// The cpu samples the PC when its cycle count passes sampleTime() (a cached
+// deadline so the disabled cost is a single compare per tick). Samples are keyed
+// by PRG bank and address. If call stacks are enabled the machine reports each
+// instruction so a shadow call stack can be kept from JSR/RTS/RTI and NMI entry
+// for flamegraph (collapsed stack) output.
+class Profiler {
+ public:
+  static const ulong s_never = ~0UL;
+
+ public:
+  Profiler(Machine *machine);
+
+  bool isEnabled() const { return enabled_; }
+
+  // start sampling every interval cycles (jittered to avoid aliasing with frame loops)
+  void start(uint interval=1000, bool callStacks=true);
+  void stop();
+
+  void clear();
+
+  bool isCallStacks() const { return enabled_ && callStacks_; }
+
+  // cpu cycle of next sample
+  ulong sampleTime() const { return sampleTime_; }
+
+  void sample(ulong cycle, ushort pc);
+
+  // track calls from executed instruction (opcode at pc, nmi if NMI was entered)
+  void traceInstruction(ushort pc, uchar opcode, bool nmi);
+
+  ulong numSamples() const { return numSamples_; }
+
+  //---
+
+  // labels file lines: "[bank:]addr name", "name = $addr" or FCEUX "$addr#name#"
+  bool loadLabels(const std::string &filename);
+
+  void addLabel(int bank, ushort addr, const std::string &name);
+
+  std::string symbolName(uint key) const;
+
+  //---
+
+  // samples per address (sorted) and per function
+  void writeReport(std::ostream &os) const;
+
+  // flamegraph.pl compatible collapsed stacks
+  void writeCollapsed(std::ostream &os) const;
+
+ private:
+  // key is (bank + 1) << 16 | address (bank 0 for non-ROM address)
+  uint makeKey(ushort addr) const;
+
+  static int    keyBank(uint key) { return int(key >> 16) - 1; }
+  static ushort keyAddr(uint key) { return ushort(key & 0xFFFF); }
+
+  const std::string *findLabel(uint key, int &offset) const;
+
+  std::string functionName(uint key) const;
+
+ private:
+  static const uint s_nmiKey   = 0xFFFFFFFF;
+  static const int  s_maxDepth = 64;
+
+  using Counts      = std::unordered_map<uint, ulong>;
+  using Stack       = std::vector<uint>;
+  using StackCounts = std::map<Stack, ulong>;
+  using AddrLabels  = std::map<ushort, std::string>;
+  using BankLabels  = std::map<int, AddrLabels>;
+
+  Machine*    machine_    { nullptr };
+  bool        enabled_    { false };
+  bool        callStacks_ { false };
+  uint        interval_   { 1000 };
+  ulong       sampleTime_ { s_never };
+  uint        seed_       { 1 };
+  ulong       numSamples_ { 0 };
+  Counts      counts_;
+  Stack       stack_;       // call targets (and NMI markers)
+  int         lostDepth_  { 0 }; // calls not pushed as stack full
+  StackCounts stackCounts_;
+  BankLabels  labels_;      // labels by bank (-1 for any bank)
+};
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef CNES_RingBuffer_H
+#define CNES_RingBuffer_H
+
+#include <CNES_Types.h>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+namespace CNES {
+
+// Single-producer/single-consumer lock-free ring buffer
+//
+// One thread may write and one other thread may read concurrently. Neither side
+// blocks: write stores what fits and read returns what is available.
+template<typename T>
+class RingBuffer {
+ public:
+  RingBuffer(uint size=0) {
+    resize(size);
+  }
+
+  // set capacity (rounded up to power of two). Not thread safe.
+  void resize(uint size) {
+    uint size1 = 1;
+
+    while (size1 < size)
+      size1 <<= 1;
+
+    data_.resize(size1);
+
+    mask_ = size1 - 1;
+
+    read_ .store(0);
+    write_.store(0);
+  }
+
+  uint capacity() const { return uint(data_.size()); }
+
+  // number of items available to read
+  uint size() const {
+    return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+  }
+
+  uint space() const { return capacity() - size(); }
+
+  // producer
+  uint write(const T *data, uint n) {
+    uint w = write_.load(std::memory_order_relaxed);
+    uint r = read_ .load(std::memory_order_acquire);
+
+    n = std::min(n, capacity() - (w - r));
+
+    for (uint i = 0; i < n; ++i)
+      data_[(w + i) & mask_] = data[i];
+
+    write_.store(w + n, std::memory_order_release);
+
+    return n;
+  }
+
+  // consumer
+  uint read(T *data, uint n) {
+    uint r = read_ .load(std::memory_order_relaxed);
+    uint w = write_.load(std::memory_order_acquire);
+
+    n = std::min(n, w - r);
+
+    for (uint i = 0; i < n; ++i)
+      data[i] = data_[(r + i) & mask_];
+
+    read_.store(r + n, std::memory_order_release);
+
+    return n;
+  }
+
+ private:
+  using Data = std::vector<T>;
+
+  Data data_;
+  uint mask_ { 0 };
+
+  // read/write counts (wrap naturally) on separate cache lines
+  alignas(64) std::atomic<uint> read_  { 0 };
+  alignas(64) std::atomic<uint> write_ { 0 };
+};
+
+}
+
+#endif
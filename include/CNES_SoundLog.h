@@ -0,0 +1,93 @@
+#ifndef CNES_SoundLog_H
+#define CNES_SoundLog_H
+
+#include <CNES_Types.h>
+#include <CNES_RingBuffer.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <cstdio>
+
+namespace CNES {
+
+// Cycle stamped log of sound register writes ($4000-$4017) saved as VGM file
+//
+// The cpu thread only appends a small event to a lock-free ring (dropping it if
+// full, never blocking). A background thread converts events to VGM commands
+// and writes the file so capture has no synthesis cost.
+class SoundLog {
+ public:
+  struct Event {
+    ulong  cycle { 0 };
+    ushort addr  { 0 };
+    uchar  value { 0 };
+  };
+
+ public:
+  SoundLog(uint size=65536);
+ ~SoundLog();
+
+  bool isOpen() const { return isOpen_; }
+
+  // start log at specified cpu cycle (clockRate in cpu cycles/second)
+  bool open(const std::string &filename, ulong cycle, double clockRate);
+
+  // stop log (cpu cycle is end of log)
+  void close(ulong cycle);
+
+  // record register write (cpu thread)
+  void log(ulong cycle, ushort addr, uchar value) {
+    if (addr < 0x4018)
+      regs_[addr & 0x1F] = value;
+
+    if (! isOpen_)
+      return;
+
+    Event event;
+
+    event.cycle = cycle;
+    event.addr  = addr;
+    event.value = value;
+
+    if (! ring_.write(&event, 1))
+      ++numDropped_;
+  }
+
+  uint numDropped() const { return numDropped_; }
+
+ private:
+  void logState(ulong cycle);
+
+  void writeThread();
+
+  void writeEvents();
+  void writeWait(ulong cycle);
+
+  void writeByte(uchar c);
+  void writeWord(ushort s);
+
+  void writeHeader();
+
+ private:
+  static const int s_vgmRate    = 44100;
+  static const int s_headerSize = 0xC0;
+
+  using Ring = RingBuffer<Event>;
+
+  Ring              ring_;
+  uchar             regs_[0x20];             // last written register values
+  bool              isOpen_      { false };
+  std::atomic<uint> numDropped_  { 0 };
+
+  // writer thread state
+  std::thread       thread_;
+  std::atomic<bool> running_     { false };
+  FILE*             fp_          { nullptr };
+  ulong             startCycle_  { 0 };
+  double            clockRate_   { 1789773.0 };
+  ulong             numSamples_  { 0 };     // samples (at vgm rate) written
+};
+
+}
+
+#endif
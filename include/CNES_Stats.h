@@ -0,0 +1,157 @@
+#ifndef CNES_Stats_H
+#define CNES_Stats_H
+
+#include <CNES_Types.h>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace CNES {
+
+// Per-subsystem counters and timers
+//
+// Only updated when built with CNES_STATS defined (the CNES_STATS_* macros
+// compile to nothing otherwise) so the default build has no overhead. Values are
+// kept for the current frame, the last completed frame and in total.
+class Stats {
+ public:
+  enum class Counter {
+    INSTRUCTIONS,
+    READ_RAM,
+    READ_IO,
+    READ_EXPANSION,
+    READ_CART_RAM,
+    READ_ROM,
+    WRITE_RAM,
+    WRITE_IO,
+    WRITE_EXPANSION,
+    WRITE_CART_RAM,
+    WRITE_ROM,
+    PPU_LINES,
+    SPRITES_IN_RANGE,
+    PIXELS_CHANGED,
+    PPU_LINES_CHANGED,
+    PPU_SPAN_HITS,
+    PPU_SPAN_MISSES,
+    NUM_COUNTERS
+  };
+
+  enum class Timer {
+    CPU_STEP,
+    PPU_DRAW_LINE,
+    PPU_SPRITES,
+    FRONTEND_DRAW,
+    EVENTS,
+    NUM_TIMERS
+  };
+
+  static const int s_numCounters = int(Counter::NUM_COUNTERS);
+  static const int s_numTimers   = int(Timer  ::NUM_TIMERS);
+
+  // time stamp counter ticks
+  static ulong ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return ulong(std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+  }
+
+  // measured tick frequency
+  static double ticksPerSecond();
+
+  // scoped timer (adds elapsed ticks on destruction)
+  class ScopedTimer {
+   public:
+    ScopedTimer(Stats &stats, Timer timer) :
+     stats_(stats), timer_(timer), start_(ticks()) {
+    }
+
+   ~ScopedTimer() {
+      stats_.addTime(timer_, ticks() - start_);
+    }
+
+   private:
+    Stats &stats_;
+    Timer  timer_;
+    ulong  start_ { 0 };
+  };
+
+ public:
+  Stats();
+
+  // true if built with CNES_STATS
+  static bool isEnabled();
+
+  void count(Counter counter, ulong n=1) { frame_.counters[int(counter)] += n; }
+
+  void addTime(Timer timer, ulong ticks) {
+    auto &t = frame_.timers[int(timer)];
+
+    t.ticks += ticks;
+
+    ++t.calls;
+  }
+
+  // move current frame values to last frame and totals
+  void endFrame();
+
+  void reset();
+
+  ulong numFrames() const { return numFrames_; }
+
+  ulong frameCount(Counter counter) const { return last_ .counters[int(counter)]; }
+  ulong totalCount(Counter counter) const { return total_.counters[int(counter)]; }
+
+  double frameTime(Timer timer) const; // seconds
+  double totalTime(Timer timer) const; // seconds
+
+  ulong totalCalls(Timer timer) const { return total_.timers[int(timer)].calls; }
+
+  static const char *counterName(Counter counter);
+  static const char *timerName  (Timer   timer);
+
+  std::string toJSON() const;
+
+ private:
+  struct TimerData {
+    ulong ticks { 0 };
+    ulong calls { 0 };
+  };
+
+  struct Values {
+    ulong     counters[s_numCounters] { };
+    TimerData timers  [s_numTimers];
+
+    void clear() { *this = Values(); }
+  };
+
+  Values frame_;               // current frame
+  Values last_;                // last completed frame
+  Values total_;
+  ulong  numFrames_ { 0 };
+};
+
+}
+
+//---
+
+#ifdef CNES_STATS
+#define CNES_STATS_COUNT(stats, counter) \
+  (stats).count(CNES::Stats::Counter::counter)
+#define CNES_STATS_COUNT_N(stats, counter, n) \
+  (stats).count(CNES::Stats::Counter::counter, n)
+#define CNES_STATS_TIMER(stats, timer) \
+  CNES::Stats::ScopedTimer statsTimer_##timer((stats), CNES::Stats::Timer::timer)
+#else
+#define CNES_STATS_COUNT(stats, counter)
+#define CNES_STATS_COUNT_N(stats, counter, n)
+#define CNES_STATS_TIMER(stats, timer)
+#endif
+
+#endif
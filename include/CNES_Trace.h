@@ -0,0 +1,141 @@
+#ifndef CNES_Trace_H
+#define CNES_Trace_H
+
+#include <CNES_Types.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace CNES {
+
+// Fixed size ring of binary bus trace events
+//
+// Recording an event is a single 16 byte store into a power of two sized ring
+// (no formatting) so tracing can be left on. The ring can be dumped to a file on
+// demand, on a breakpoint or from a crash signal handler and decoded to text
+// offline (CNESTraceDecode).
+class Trace {
+ public:
+  enum class Kind : uchar {
+    RAM_READ,
+    IO_READ,
+    EXPANSION_READ,
+    CART_RAM_READ,
+    ROM_READ,
+    RAM_WRITE,
+    IO_WRITE,
+    EXPANSION_WRITE,
+    CART_RAM_WRITE,
+    ROM_WRITE,
+    PPU_READ,
+    PPU_WRITE,
+    SPRITE_READ,
+    APU_WRITE,
+    MAPPER_WRITE,
+    MARK,
+    NUM_KINDS
+  };
+
+  struct Event {
+    ulong  cycle { 0 };
+    ushort pc    { 0 };
+    ushort addr  { 0 };
+    uchar  value { 0 };
+    Kind   kind  { Kind::MARK };
+    ushort pad   { 0 };
+  };
+
+  static_assert(sizeof(Event) == 16, "trace event must be 16 bytes");
+
+  using Events = std::vector<Event>;
+
+ public:
+  Trace(uint size=1<<20);
+ ~Trace();
+
+  // ring is allocated when first enabled
+  bool isEnabled() const { return enabled_; }
+  void setEnabled(bool b);
+
+  // number of events kept (rounded up to power of two)
+  uint size() const { return mask_ + 1; }
+  void resize(uint size);
+
+  // record event (and print it if echo)
+  void add(ulong cycle, ushort pc, ushort addr, uchar value, Kind kind, bool echo=false) {
+    if (enabled_) {
+      Event event;
+
+      event.cycle = cycle;
+      event.pc    = pc;
+      event.addr  = addr;
+      event.value = value;
+      event.kind  = kind;
+
+      events_[pos_++ & mask_] = event;
+    }
+
+    if (echo)
+      echoEvent(cycle, pc, addr, value, kind);
+  }
+
+  void clear() { pos_ = 0; }
+
+  // total events recorded (including overwritten)
+  ulong numEvents() const { return pos_; }
+
+  // copy last (at most maxEvents, 0 for all) events oldest first
+  void getEvents(Events &events, uint maxEvents=0) const;
+
+  //---
+
+  // dump file used by breakpoint and crash triggers
+  const std::string &dumpFile() const { return dumpFile_; }
+  void setDumpFile(const std::string &filename) { dumpFile_ = filename; }
+
+  bool isDumpOnBreakpoint() const { return dumpOnBreakpoint_; }
+  void setDumpOnBreakpoint(bool b) { dumpOnBreakpoint_ = b; }
+
+  // write last (at most maxEvents) events to binary file
+  bool dump(const std::string &filename, uint maxEvents=0) const;
+
+  // dump to dump file if set
+  bool dump() const;
+
+  // dump to dump file on SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT
+  void installCrashHandler();
+
+  //---
+
+  // read binary dump file
+  static bool readFile(const std::string &filename, Events &events, ulong &numEvents);
+
+  static const char *kindName(Kind kind);
+
+  static void print(std::ostream &os, const Event &event);
+
+ private:
+  void echoEvent(ulong cycle, ushort pc, ushort addr, uchar value, Kind kind) const;
+
+  // async signal safe dump (no allocation)
+  void crashDump() const;
+
+  static void crashHandler(int sig);
+
+ private:
+  static const char  s_magic[8];
+  static const uint  s_version = 1;
+
+  static Trace* s_crashTrace;
+
+  Events      events_;
+  uint        mask_             { 0 };
+  ulong       pos_              { 0 };
+  bool        enabled_          { false };
+  std::string dumpFile_;
+  bool        dumpOnBreakpoint_ { false };
+};
+
+}
+
+#endif
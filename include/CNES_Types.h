@@ -5,6 +5,8 @@ namespace CNES {
 
 using uchar  = unsigned char;
 using ushort = unsigned short;
+using uint   = unsigned int;
+using ulong  = unsigned long;
 
 }
 
@@ -6,6 +6,7 @@
 
 class CQNESPPUMem;
 class CQ6502HexEdit;
+class QTimer;
 
 namespace CNES {
 
@@ -43,6 +44,8 @@ class CQNESDbg : public CQ6502Dbg {
 
   void updatePPUSlot(ushort addr, ushort len);
 
+  void refreshSlot();
+
   void ppuMemEnabledSlot();
 
   void illegalJumpSlot();
@@ -50,7 +53,8 @@ class CQNESDbg : public CQ6502Dbg {
   void nmiSlot();
 
  private:
-  CNES::QMachine *machine_ { nullptr };
+  CNES::QMachine *machine_      { nullptr };
+  QTimer*         refreshTimer_ { nullptr };
 
   struct NESData {
     QGroupBox*     group                 { nullptr };
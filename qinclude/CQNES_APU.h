@@ -0,0 +1,42 @@
+#ifndef CQNES_APU_H
+#define CQNES_APU_H
+
+#include <CNES_AudioSink.h>
+#include <QIODevice>
+
+class QAudioOutput;
+
+namespace CNES {
+
+class QMachine;
+
+// Qt audio output of APU samples
+//
+// Emulation writes frames of samples into a lock-free ring (sink) and the audio
+// device pulls them from this device so the emulation never blocks on audio.
+class QAPUOutput : public QIODevice {
+  Q_OBJECT
+
+ public:
+  QAPUOutput(QMachine *qmachine);
+ ~QAPUOutput();
+
+  RingAudioSink *sink() { return &sink_; }
+
+  void start();
+  void stop();
+
+  qint64 readData(char *data, qint64 maxlen) override;
+  qint64 writeData(const char *data, qint64 len) override;
+
+ private:
+  static const int s_sampleRate = 44100;
+
+  QMachine*     qmachine_ { nullptr };
+  RingAudioSink sink_;
+  QAudioOutput* output_   { nullptr };
+};
+
+}
+
+#endif
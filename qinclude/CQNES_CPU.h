@@ -23,7 +23,7 @@ class QCPU : public QObject, public CPU {
   void memChanged(ushort addr, ushort len) override { emit memChangedSignal(addr, len); }
 
   void handleBreak  () override { emit handleBreakSignal(); }
-  void breakpointHit() override { emit breakpointHitSignal(); }
+  void breakpointHit() override { CPU::breakpointHit(); emit breakpointHitSignal(); }
   void illegalJump  () override { emit illegalJumpSignal(); }
   void handleNMI    () override { emit nmiSignal(); }
 
@@ -3,8 +3,8 @@
 
 #include <CNES_Cartridge.h>
 #include <QWidget>
-
-class QPainter;
+#include <QImage>
+#include <vector>
 
 namespace CNES {
 
@@ -26,18 +26,24 @@ class QCartridge : public QWidget, public Cartridge {
 
   void mousePressEvent(QMouseEvent *e) override;
 
-  void setColor(uchar c) override;
-  void drawPixel(int x, int y) override;
-
   QSize sizeHint() const override;
 
  private:
-  QMachine *qmachine_ { nullptr };
-  QPainter *painter_  { nullptr };
-  int       scale_    { 4 };
-  int       border_   { 8 };
-  int       ntx_      { 1 };
-  int       nty_      { 1 };
+  void updateSheet();
+
+ private:
+  using Images = std::vector<QImage>;
+
+  QMachine *qmachine_     { nullptr };
+  int       scale_        { 4 };
+  int       border_       { 8 };
+  int       ntx_          { 1 };
+  int       nty_          { 1 };
+  Images    bankImages_;             // cached native image per 4K bank
+  QImage    sheetImage_;             // cached scaled image of all banks
+  bool      sheetValid_   { false };
+  ulong     sheetVersion_ { 0 };     // cartridge chr version of sheet image
+  int       sheetScale_   { 0 };     // scale of sheet image
 };
 
 }
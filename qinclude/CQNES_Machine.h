@@ -11,6 +11,7 @@ class QCPU;
 class QPPU;
 class QCartridge;
 class QPPU_Sprites;
+class QAPUOutput;
 
 class QMachine : public QObject, public Machine {
   Q_OBJECT
@@ -26,6 +27,8 @@ class QMachine : public QObject, public Machine {
 
   QPPU_Sprites *getSprites() const { return sprites_; }
 
+  QAPUOutput *getAPUOutput() const { return apuOutput_; }
+
   QWidget *dbgWidget() const { return dbgWidget_.data(); }
   void setDbgWidget(QWidget *p) { dbgWidget_ = p; }
 
@@ -53,6 +56,8 @@ class QMachine : public QObject, public Machine {
 
   QPPU_Sprites *sprites_ { nullptr };
 
+  QAPUOutput *apuOutput_ { nullptr };
+
   WidgetP dbgWidget_;
 };
 
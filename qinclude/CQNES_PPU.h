@@ -3,12 +3,15 @@
 
 #include <CNES_PPU.h>
 #include <QWidget>
+#include <QImage>
+#include <memory>
 
 class QPainter;
 
 namespace CNES {
 
 class QMachine;
+class NTSCFilter;
 
 class QPPU : public QWidget, public PPU {
   Q_OBJECT
@@ -16,10 +19,14 @@ class QPPU : public QWidget, public PPU {
   Q_PROPERTY(int  scale        READ scale          WRITE setScale       )
   Q_PROPERTY(int  margin       READ margin         WRITE setMargin      )
   Q_PROPERTY(bool showScanLine READ isShowScanLine WRITE setShowScanLine)
+  Q_PROPERTY(bool smooth       READ isSmooth       WRITE setSmooth      )
+  Q_PROPERTY(bool ntsc         READ isNTSC         WRITE setNTSC        )
 
  public:
   QPPU(QMachine *qmachine);
 
+ ~QPPU();
+
   //---
 
   int scale() const { return scale_; }
@@ -31,14 +38,20 @@ class QPPU : public QWidget, public PPU {
   bool isShowScanLine() const { return showScanLine_; }
   void setShowScanLine(bool b) { showScanLine_ = b; }
 
+  bool isSmooth() const { return smooth_; }
+  void setSmooth(bool b) { smooth_ = b; update(); }
+
+  // NTSC composite filter (602 wide image)
+  bool isNTSC() const { return bool(ntsc_); }
+  void setNTSC(bool b);
+
   //---
 
   void memChanged(ushort addr, ushort len) override { emit memChangedSignal(addr, len); }
 
   void spritesChanged() override { emit spritesChangedSignal(); }
 
-  bool isKey1(int n) override;
-  bool isKey2(int n) override;
+  void linesDrawn() override { needsUpdate_ = true; }
 
   //---
 
@@ -77,27 +90,39 @@ class QPPU : public QWidget, public PPU {
   void showSprites(bool);
   void showDebug(bool);
 
+  void setSmoothSlot(bool);
+  void setNTSCSlot(bool);
+
  private:
+  bool setKey(int key, bool pressed);
+
   void updateImage();
 
- private:
-  using KeyPressed = std::map<int,bool>;
+  void updateScreenImage(bool all=false);
+
+  QRect screenRect(const DamageRect &rect) const;
 
-  // 60Hz
+ private:
+  // 60Hz (display refresh, emulation is paced by Machine::runFrame)
   static const int s_cycleTime = 1000/s_displaySpeed;
 
   QMachine*  qmachine_     { nullptr };
   QTimer*    timer_        { nullptr };
-  QImage*    image_        { nullptr };
-  QPainter*  ipainter_     { nullptr };
+  QImage     image_;                   // native resolution (or NTSC) visible screen
+  QImage*    drawImage_    { nullptr }; // current drawPixel target (sprite drawing)
+  int        drawDX_       { 0 };       // drawPixel x offset into target
+  int        drawDY_       { 0 };       // drawPixel y offset into target
+  QRgb       rgb_          { 0 };       // current drawPixel color
   int        iw_           { 0 };
   int        ih_           { 0 };
   int        scale_        { 1 };
   int        margin_       { 0 };
   bool       showScanLine_ { false };
+  bool       smooth_       { false };
   bool       updateImage_  { true };
-  int        lineNum_      { 0 };
-  KeyPressed keyPressed_;
+  bool       needsUpdate_  { false };
+
+  std::unique_ptr<NTSCFilter> ntsc_;
 };
 
 }
@@ -2,7 +2,7 @@ TEMPLATE = lib
 
 TARGET = CQNES
 
-QT += widgets
+QT += widgets multimedia
 
 DEPENDPATH += .
 
@@ -14,7 +14,11 @@ MOC_DIR = .moc
 CONFIG += staticlib
 CONFIG += c++14
 
+# instrumentation counters/timers (match core library build)
+#DEFINES += CNES_STATS
+
 SOURCES += \
+CQNES_APU.cpp \
 CQNES_Cartridge.cpp \
 CQNES_CPU.cpp \
 CQNES_Machine.cpp \
@@ -22,6 +26,7 @@ CQNES_PPU.cpp \
 CQNES_Sprites.cpp \
 
 HEADERS += \
+../qinclude/CQNES_APU.h \
 ../qinclude/CQNES_Cartridge.h \
 ../qinclude/CQNES_CPU.h \
 ../qinclude/CQNES_Machine.h \
@@ -0,0 +1,79 @@
+#include <CQNES_APU.h>
+#include <CQNES_Machine.h>
+
+#include <QAudioOutput>
+
+namespace CNES {
+
+QAPUOutput::
+QAPUOutput(QMachine *qmachine) :
+ QIODevice(qmachine), qmachine_(qmachine), sink_(s_sampleRate, 0.040)
+{
+  setObjectName("apuOutput");
+
+  QAudioFormat format;
+
+  format.setSampleRate(s_sampleRate);
+  format.setChannelCount(1);
+  format.setSampleSize(16);
+  format.setCodec("audio/pcm");
+  format.setByteOrder(QAudioFormat::LittleEndian);
+  format.setSampleType(QAudioFormat::SignedInt);
+
+  output_ = new QAudioOutput(format, this);
+
+  // small device buffer (ring provides the latency). Latency budget (40ms): device
+  // buffer (10ms) + ring at frame start (fill target, a quarter of 40ms) + frame of
+  // samples written after it (16.7ms)
+  output_->setBufferSize(int(s_sampleRate*0.010)*sizeof(short));
+}
+
+QAPUOutput::
+~QAPUOutput()
+{
+  stop();
+}
+
+void
+QAPUOutput::
+start()
+{
+  if (! isOpen())
+    open(QIODevice::ReadOnly);
+
+  output_->start(this);
+}
+
+void
+QAPUOutput::
+stop()
+{
+  output_->stop();
+
+  if (isOpen())
+    close();
+}
+
+// pulled by audio device (pads with silence on underrun so device keeps running)
+qint64
+QAPUOutput::
+readData(char *data, qint64 maxlen)
+{
+  int n = int(maxlen/sizeof(short));
+
+  if (n <= 0)
+    return 0;
+
+  sink_.readSamples(reinterpret_cast<short *>(data), n);
+
+  return n*sizeof(short);
+}
+
+qint64
+QAPUOutput::
+writeData(const char *, qint64)
+{
+  return -1;
+}
+
+}
@@ -6,6 +6,7 @@
 #include <QMouseEvent>
 
 #include <iostream>
+#include <thread>
 #include <cmath>
 
 namespace CNES {
@@ -43,15 +44,93 @@ void
 QCartridge::
 paintEvent(QPaintEvent *)
 {
+  updateState();
+
+  updateSheet();
+
   QPainter painter(this);
 
   painter.fillRect(rect(), Qt::black);
 
-  painter_ = &painter;
+  painter.drawImage(0, 0, sheetImage_);
+}
 
-  updateState();
+// rebuild cached images when chr data, bank mapping or scale changes
+void
+QCartridge::
+updateSheet()
+{
+  if (sheetValid_ && sheetVersion_ == chrVersion() && sheetScale_ == scale())
+    return;
+
+  sheetValid_   = true;
+  sheetVersion_ = chrVersion();
+  sheetScale_   = scale();
+
+  //---
+
+  // decode banks in parallel (each thread writes separate images)
+  static QVector<QRgb> colors {
+    qRgb(0, 0, 0), qRgb(85, 85, 85), qRgb(170, 170, 170), qRgb(255, 255, 255),
+  };
+
+  int nt = numTiles();
+
+  bankImages_.resize(nt);
+
+  std::vector<uchar *> bankPixels(nt);
+
+  for (int it = 0; it < nt; ++it) {
+    auto &image = bankImages_[it];
+
+    if (image.isNull()) {
+      image = QImage(16*8, 16*8, QImage::Format_Indexed8);
+
+      image.setColorTable(colors);
+    }
+
+    bankPixels[it] = image.bits(); // detach in gui thread
+  }
+
+  int stride = (nt > 0 ? bankImages_[0].bytesPerLine() : 0);
+
+  int nthreads = std::min(nt, std::max(int(std::thread::hardware_concurrency()), 1));
+
+  std::vector<std::thread> threads;
+
+  for (int ithread = 0; ithread < nthreads; ++ithread) {
+    threads.emplace_back([&, ithread]() {
+      for (int it = ithread; it < nt; it += nthreads)
+        getTilePixels(it, bankPixels[it], stride);
+    });
+  }
+
+  for (auto &thread : threads)
+    thread.join();
 
-  drawTiles();
+  //---
+
+  // compose scaled sheet so paint is a single blit
+  QSize s = sizeHint();
+
+  sheetImage_ = QImage(s.width(), s.height(), QImage::Format_ARGB32);
+
+  sheetImage_.fill(Qt::black);
+
+  QPainter painter(&sheetImage_);
+
+  int tileWidth  = 16*8;
+  int tileHeight = 16*8;
+
+  for (int it = 0; it < nt; ++it) {
+    int itx = it % ntx_;
+    int ity = it / ntx_;
+
+    int x1 = itx*tileWidth *scale() + (itx + 1)*border();
+    int y1 = ity*tileHeight*scale() + (ity + 1)*border();
+
+    painter.drawImage(QRect(x1, y1, tileWidth*scale(), tileHeight*scale()), bankImages_[it]);
+  }
 }
 
 void
@@ -81,60 +160,6 @@ mousePressEvent(QMouseEvent *e)
                "(" << CStrUtil::toHexString(ia, 2) << ")\n";
 }
 
-void
-QCartridge::
-setColor(uchar c)
-{
-#if 0
-  static QColor colors[64] {
-    QColor( 84,  84,  84), QColor(  0,  30, 116), QColor(  8,  16, 144), QColor( 48,   0, 136),
-    QColor( 68,   0, 100), QColor( 92,   0,  48), QColor( 84,   4,   0), QColor( 60,  24,   0),
-    QColor( 32,  42,   0), QColor(  8,  58,   0), QColor(  0,  64,   0), QColor(  0,  60,   0),
-    QColor(  0,  50,  60), QColor(  0,   0,   0), QColor(  0,   0,   0), QColor(  0,   0,   0),
-
-    QColor(152, 150, 152), QColor(  8,  76, 196), QColor( 48,  50, 236), QColor( 92,  30, 228),
-    QColor(136,  20, 176), QColor(160,  20, 100), QColor(152,  34,  32), QColor(120,  60,   0),
-    QColor( 84,  90,   0), QColor( 40, 114,   0), QColor(  8, 124,   0), QColor(  0, 118,  40),
-    QColor(  0, 102, 120), QColor(  0,   0,   0), QColor(  0,   0,   0), QColor(  0,   0,   0),
-
-    QColor(236, 238, 236), QColor( 76, 154, 236), QColor(120, 124, 236), QColor(176,  98, 236),
-    QColor(228,  84, 236), QColor(236,  88, 180), QColor(236, 106, 100), QColor(212, 136,  32),
-    QColor(160, 170,   0), QColor(116, 196,   0), QColor( 76, 208,  32), QColor( 56, 204, 108),
-    QColor( 56, 180, 204), QColor( 60,  60,  60), QColor(  0,   0,   0), QColor(  0,   0,   0),
-
-    QColor(236, 238, 236), QColor(168, 204, 236), QColor(188, 188, 236), QColor(212, 178, 236),
-    QColor(236, 174, 236), QColor(236, 174, 212), QColor(236, 180, 176), QColor(228, 196, 144),
-    QColor(204, 210, 120), QColor(180, 222, 120), QColor(168, 226, 144), QColor(152, 226, 180),
-    QColor(160, 214, 228), QColor(160, 162, 160), QColor(  0,   0,   0), QColor(  0,   0,   0),
-  };
-#endif
-  static QColor colors[64] {
-    QColor(0, 0, 0), QColor(85, 85, 85), QColor(170, 170, 170), QColor(255, 255, 255),
-  };
-
-  painter_->setPen(colors[c & 0x03]);
-}
-
-void
-QCartridge::
-drawPixel(int x, int y)
-{
-  ushort tileWidth  = 16*8;
-  ushort tileHeight = 16*8;
-
-  int itx = currentTile_ % ntx_;
-  int ity = currentTile_ / ntx_;
-
-  int x1 = (x + itx*tileWidth )*scale() + (itx + 1)*border();
-  int y1 = (y + ity*tileHeight)*scale() + (ity + 1)*border();
-
-  for (int isy = 0; isy < scale(); ++isy) {
-    for (int isx = 0; isx < scale(); ++isx) {
-      painter_->drawPoint(x1 + isx, y1 + isy);
-    }
-  }
-}
-
 QSize
 QCartridge::
 sizeHint() const
@@ -3,6 +3,7 @@
 #include <CQNES_PPU.h>
 #include <CQNES_Cartridge.h>
 #include <CQNES_Sprites.h>
+#include <CQNES_APU.h>
 
 namespace CNES {
 
@@ -42,6 +43,17 @@ init()
   //---
 
   Machine::init();
+
+  //---
+
+  apuOutput_ = new QAPUOutput(this);
+
+  setAudioSink(apuOutput_->sink());
+
+  // pace frames by audio output consumption
+  pacer().setMode(Pacer::Mode::AUDIO);
+
+  apuOutput_->start();
 }
 
 }
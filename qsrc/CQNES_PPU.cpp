@@ -1,4 +1,6 @@
 #include <CQNES_PPU.h>
+#include <CNES_Palette.h>
+#include <CNES_NTSC.h>
 #include <CQNES_CPU.h>
 #include <CQNES_Machine.h>
 #include <CQNES_Cartridge.h>
@@ -34,6 +36,14 @@ QPPU(QMachine *qmachine) :
 
   //---
 
+  // native resolution image for visible screen (scaled on paint, updated from
+  // changed screen lines)
+  image_ = QImage(s_visiblePixels, s_visibleLines, QImage::Format_ARGB32);
+
+  image_.fill(0);
+
+  //---
+
   timer_ = new QTimer;
 
   connect(timer_, SIGNAL(timeout()), this, SLOT(drawLineSlot()));
@@ -41,6 +51,11 @@ QPPU(QMachine *qmachine) :
   timer_->start(s_cycleTime);
 }
 
+QPPU::
+~QPPU()
+{
+}
+
 void
 QPPU::
 setScale(int scale)
@@ -52,6 +67,27 @@ setScale(int scale)
   }
 }
 
+void
+QPPU::
+setNTSC(bool b)
+{
+  if (b == isNTSC())
+    return;
+
+  if (b)
+    ntsc_ = std::make_unique<NTSCFilter>();
+  else
+    ntsc_.reset();
+
+  int w = (ntsc_ ? NTSCFilter::outputWidth(s_visiblePixels) : s_visiblePixels);
+
+  image_ = QImage(w, s_visibleLines, QImage::Format_ARGB32);
+
+  updateScreenImage(/*all*/true);
+
+  update();
+}
+
 void
 QPPU::
 setMargin(int margin)
@@ -67,30 +103,76 @@ void
 QPPU::
 drawLineSlot()
 {
-  if (numDrawLines_ > 0) {
-    updateImage();
+  // draw any lines not already drawn by Machine::runFrame
+  drawPendingLines();
 
-#if 0
-    // scan line
-    ipainter_->setPen(Qt::black);
+  updateImage();
 
-    int py = scale()*lineNum_;
+  // convert and repaint changed screen region only (none for static frames,
+  // whole screen for NTSC filter)
+  if (! damage().isEmpty()) {
+    if (isNTSC())
+      update();
+    else
+      update(screenRect(damage()));
 
-    for (int isy = 0; isy < scale(); ++isy)
-      ipainter_->drawLine(0, py + isy, width() - 1, py + isy);
-#endif
+    updateScreenImage();
+  }
 
-    for (int i = 0; i < numDrawLines_; ++i) {
-      drawLine(lineNum_++);
+  // scan line moves on every drawn line
+  if (needsUpdate_) {
+    needsUpdate_ = false;
 
-      if (lineNum_ >= s_numLines)
-        lineNum_ = 0;
-    }
+    if (isShowScanLine())
+      update();
+  }
+}
 
-    numDrawLines_ = 0;
+// convert changed screen pixels (dirty lines, or all) to image (ARGB32 is BGRA
+// bytes). NTSC filter output depends on neighbouring pixels and frame phase so
+// whole screen is filtered
+void
+QPPU::
+updateScreenImage(bool all)
+{
+  const ushort *pixels = screenPixels();
+
+  if (ntsc_) {
+    ntsc_->filter(pixels, s_visiblePixels, s_visibleLines, s_visiblePixels, frameNum(),
+                  Palette::Format::BGRA8888, image_.bits(), image_.bytesPerLine());
 
-    update();
+    clearDamage();
+
+    return;
   }
+
+  int y1 = (all ? 0 : damage().y1);
+  int y2 = (all ? s_visibleLines : damage().y2);
+
+  for (int y = y1; y < y2; ++y) {
+    int x1 = 0, x2 = s_visiblePixels;
+
+    if (! all && ! lineDamage(y, x1, x2))
+      continue;
+
+    uchar *line = image_.scanLine(y) + 4*x1;
+
+    Palette::convertLine(&pixels[y*s_visiblePixels + x1], x2 - x1,
+                         Palette::Format::BGRA8888, line);
+  }
+
+  clearDamage();
+}
+
+// widget rect of screen region
+QRect
+QPPU::
+screenRect(const DamageRect &rect) const
+{
+  int s = scale();
+
+  return QRect((s_leftMargin + rect.x1)*s + margin(), (s_topMargin + rect.y1)*s + margin(),
+               (rect.x2 - rect.x1)*s, (rect.y2 - rect.y1)*s);
 }
 
 void
@@ -100,9 +182,6 @@ updateImage()
   if (updateImage_) {
     updateImage_ = false;
 
-    delete ipainter_;
-    delete image_;
-
     // Screen: 32 x 32 (plus margins)
     int xm = margin();
     int ym = margin();
@@ -112,12 +191,6 @@ updateImage()
 
     iw_ = w + 2*xm;
     ih_ = h + 2*ym;
-
-    image_ = new QImage(iw_, ih_, QImage::Format_ARGB32);
-
-    image_->fill(0);
-
-    ipainter_ = new QPainter(image_);
   }
 }
 
@@ -131,6 +204,8 @@ void
 QPPU::
 paintEvent(QPaintEvent *)
 {
+  CNES_STATS_TIMER(qmachine_->stats(), FRONTEND_DRAW);
+
   updateImage();
 
   //---
@@ -140,19 +215,21 @@ paintEvent(QPaintEvent *)
   // TODO: get bg color from PPU
   painter.fillRect(rect(), Qt::black);
 
-  if (image_)
-    painter.drawImage(0, 0, *image_);
-
-  //---
-
-  // regions
-  painter.setPen(QColor(128,128,128));
+  // scale visible screen image (nearest neighbour unless smooth)
+  painter.setRenderHint(QPainter::SmoothPixmapTransform, isSmooth());
 
   int x = s_leftMargin   *scale();
   int w = s_visiblePixels*scale();
   int y = (s_vsyncLines + s_vblank1Lines)*scale();
   int h = s_visibleLines*scale();
 
+  painter.drawImage(QRect(x + margin(), y + margin(), w, h), image_);
+
+  //---
+
+  // regions
+  painter.setPen(QColor(128,128,128));
+
   painter.drawRect(QRect(x, y, w, h));
 
   //---
@@ -161,7 +238,7 @@ paintEvent(QPaintEvent *)
   if (isShowScanLine()) {
     painter.setPen(QColor(0,255,0));
 
-    int py = lineNum_*scale();
+    int py = lineNum()*scale();
 
     for (int isy = 0; isy < scale(); ++isy)
       painter.drawLine(0, py + isy, width() - 1, py + isy);
@@ -172,45 +249,53 @@ void
 QPPU::
 keyPressEvent(QKeyEvent *e)
 {
-  keyPressed_[e->key()] = true;
+  if (! setKey(e->key(), true))
+    QWidget::keyPressEvent(e);
 }
 
 void
 QPPU::
 keyReleaseEvent(QKeyEvent *e)
 {
-  keyPressed_[e->key()] = false;
+  if (! setKey(e->key(), false))
+    QWidget::keyReleaseEvent(e);
 }
 
+// publish key state to controller input (read by emulation on strobe)
 bool
 QPPU::
-isKey1(int n)
+setKey(int key, bool pressed)
 {
-  Qt::Key key;
-
-  if      (n == 0) key = Qt::Key_A;
-  else if (n == 1) key = Qt::Key_B;
-  else if (n == 2) key = Qt::Key_Insert; // SELECT
-  else if (n == 3) key = Qt::Key_Delete; // START
-  else if (n == 4) key = Qt::Key_Up;
-  else if (n == 5) key = Qt::Key_Down;
-  else if (n == 6) key = Qt::Key_Left;
-  else if (n == 7) key = Qt::Key_Right;
-  else             return false;
-
-  auto p = keyPressed_.find(key);
-
-  if (p != keyPressed_.end())
-    return (*p).second;
+  int           i      = 0;
+  Input::Button button = Input::BUTTON_A;
+
+  switch (key) {
+    // controller 1
+    case Qt::Key_A     : i = 0; button = Input::BUTTON_A     ; break;
+    case Qt::Key_B     : i = 0; button = Input::BUTTON_B     ; break;
+    case Qt::Key_Insert: i = 0; button = Input::BUTTON_SELECT; break;
+    case Qt::Key_Delete: i = 0; button = Input::BUTTON_START ; break;
+    case Qt::Key_Up    : i = 0; button = Input::BUTTON_UP    ; break;
+    case Qt::Key_Down  : i = 0; button = Input::BUTTON_DOWN  ; break;
+    case Qt::Key_Left  : i = 0; button = Input::BUTTON_LEFT  ; break;
+    case Qt::Key_Right : i = 0; button = Input::BUTTON_RIGHT ; break;
+
+    // controller 2
+    case Qt::Key_G     : i = 1; button = Input::BUTTON_A     ; break;
+    case Qt::Key_H     : i = 1; button = Input::BUTTON_B     ; break;
+    case Qt::Key_T     : i = 1; button = Input::BUTTON_SELECT; break;
+    case Qt::Key_Y     : i = 1; button = Input::BUTTON_START ; break;
+    case Qt::Key_I     : i = 1; button = Input::BUTTON_UP    ; break;
+    case Qt::Key_K     : i = 1; button = Input::BUTTON_DOWN  ; break;
+    case Qt::Key_J     : i = 1; button = Input::BUTTON_LEFT  ; break;
+    case Qt::Key_L     : i = 1; button = Input::BUTTON_RIGHT ; break;
+
+    default: return false;
+  }
 
-  return false;
-}
+  qmachine_->input().setButton(i, button, pressed);
 
-bool
-QPPU::
-isKey2(int /*n*/)
-{
-  return false;
+  return true;
 }
 
 void
@@ -253,6 +338,20 @@ contextMenuEvent(QContextMenuEvent *e)
 
   connect(spritesAction, SIGNAL(triggered(bool)), this, SLOT(showSprites(bool)));
 
+  QAction *smoothAction = menu->addAction("Smooth Scaling");
+
+  smoothAction->setCheckable(true);
+  smoothAction->setChecked  (isSmooth());
+
+  connect(smoothAction, SIGNAL(triggered(bool)), this, SLOT(setSmoothSlot(bool)));
+
+  QAction *ntscAction = menu->addAction("NTSC Filter");
+
+  ntscAction->setCheckable(true);
+  ntscAction->setChecked  (isNTSC());
+
+  connect(ntscAction, SIGNAL(triggered(bool)), this, SLOT(setNTSCSlot(bool)));
+
   if (qmachine_->dbgWidget()) {
     QAction *debugAction = menu->addAction("Show Debug");
 
@@ -290,69 +389,69 @@ showDebug(bool show)
   qmachine_->dbgWidget()->setVisible(show);
 }
 
+void
+QPPU::
+setSmoothSlot(bool b)
+{
+  setSmooth(b);
+}
+
+void
+QPPU::
+setNTSCSlot(bool b)
+{
+  setNTSC(b);
+}
+
 void
 QPPU::
 setColor(uchar c)
 {
-  static QColor colors[64] {
-    QColor( 84,  84,  84), QColor(  0,  30, 116), QColor(  8,  16, 144), QColor( 48,   0, 136),
-    QColor( 68,   0, 100), QColor( 92,   0,  48), QColor( 84,   4,   0), QColor( 60,  24,   0),
-    QColor( 32,  42,   0), QColor(  8,  58,   0), QColor(  0,  64,   0), QColor(  0,  60,   0),
-    QColor(  0,  50,  60), QColor(  0,   0,   0), QColor(  0,   0,   0), QColor(  0,   0,   0),
-
-    QColor(152, 150, 152), QColor(  8,  76, 196), QColor( 48,  50, 236), QColor( 92,  30, 228),
-    QColor(136,  20, 176), QColor(160,  20, 100), QColor(152,  34,  32), QColor(120,  60,   0),
-    QColor( 84,  90,   0), QColor( 40, 114,   0), QColor(  8, 124,   0), QColor(  0, 118,  40),
-    QColor(  0, 102, 120), QColor(  0,   0,   0), QColor(  0,   0,   0), QColor(  0,   0,   0),
-
-    QColor(236, 238, 236), QColor( 76, 154, 236), QColor(120, 124, 236), QColor(176,  98, 236),
-    QColor(228,  84, 236), QColor(236,  88, 180), QColor(236, 106, 100), QColor(212, 136,  32),
-    QColor(160, 170,   0), QColor(116, 196,   0), QColor( 76, 208,  32), QColor( 56, 204, 108),
-    QColor( 56, 180, 204), QColor( 60,  60,  60), QColor(  0,   0,   0), QColor(  0,   0,   0),
-
-    QColor(236, 238, 236), QColor(168, 204, 236), QColor(188, 188, 236), QColor(212, 178, 236),
-    QColor(236, 174, 236), QColor(236, 174, 212), QColor(236, 180, 176), QColor(228, 196, 144),
-    QColor(204, 210, 120), QColor(180, 222, 120), QColor(168, 226, 144), QColor(152, 226, 180),
-    QColor(160, 214, 228), QColor(160, 162, 160), QColor(  0,   0,   0), QColor(  0,   0,   0),
-  };
-
-  QColor color = colors[c & 0x3F];
-
-  if (isEmphasizeRed() || isEmphasizeGreen() || isEmphasizeBlue()) {
-    QColor color1 = color.lighter();
-    QColor color2 = color.darker ();
-
-    color = QColor(isEmphasizeRed  () ? color1.red  () : color2.red  (),
-                   isEmphasizeGreen() ? color1.green() : color2.green(),
-                   isEmphasizeBlue () ? color1.blue () : color2.blue ());
-  }
+  uchar r, g, b;
+
+  Palette::rgb(ushort((emphasisBits() << 8) | (c & 0x3F)), r, g, b);
 
-  ipainter_->setPen(color);
+  rgb_ = qRgb(r, g, b);
 }
 
+// write pixel directly into target image (custom sprite drawing)
 void
 QPPU::
 drawPixel(int x, int y)
 {
-  int s = scale();
+  if (! drawImage_)
+    return;
 
-  int x1 = x*s + margin();
-  int y1 = y*s + margin();
+  int x1 = x + drawDX_;
+  int y1 = y + drawDY_;
 
-  for (int isy = 0; isy < s; ++isy) {
-    for (int isx = 0; isx < s; ++isx) {
-      ipainter_->drawPoint(x1 + isx, y1 + isy);
-    }
-  }
+  if (x1 < 0 || x1 >= drawImage_->width() || y1 < 0 || y1 >= drawImage_->height())
+    return;
+
+  auto *line = reinterpret_cast<QRgb *>(drawImage_->scanLine(y1));
+
+  line[x1] = rgb_;
 }
 
 void
 QPPU::
 drawSprites(QPainter *painter, bool alt)
 {
-  QPainter *ipainter1 = ipainter_;
+  int w = 8;
+  int h = 8;
+
+  // draw 8x8 grid of sprites at native resolution
+  QImage spriteImage(8*w, 8*h, QImage::Format_ARGB32);
+
+  spriteImage.fill(0);
 
-  ipainter_ = painter;
+  QImage *drawImage1 = drawImage_;
+  int     drawDX1    = drawDX_;
+  int     drawDY1    = drawDY_;
+
+  drawImage_ = &spriteImage;
+  drawDX_    = 0;
+  drawDY_    = 0;
 
   ushort spritePatternAddr = spritePatternAddr_;
 
@@ -360,9 +459,6 @@ drawSprites(QPainter *painter, bool alt)
 
   int o = (alt ? 1 : 0);
 
-  int w = 8;
-  int h = 8;
-
   for (int iy = 0; iy < 8; ++iy) {
     for (int ix = 0; ix < 8; ++ix) {
       int i = iy*8 + ix;
@@ -373,7 +469,15 @@ drawSprites(QPainter *painter, bool alt)
 
   spritePatternAddr_ = spritePatternAddr;
 
-  ipainter_ = ipainter1;
+  drawImage_ = drawImage1;
+  drawDX_    = drawDX1;
+  drawDY_    = drawDY1;
+
+  //---
+
+  int s = scale();
+
+  painter->drawImage(QRect(0, 0, spriteImage.width()*s, spriteImage.height()*s), spriteImage);
 }
 
 QSize
@@ -4,6 +4,8 @@
 #include <CQNES_Cartridge.h>
 #include <CQApp.h>
 #include <iostream>
+#include <fstream>
+#include <cstdlib>
 
 using namespace CNES;
 
@@ -12,7 +14,17 @@ main(int argc, char **argv)
 {
   CQApp app(argc, argv);
 
-  bool debug = false;
+  bool debug       = false;
+  int  speed       = 1;
+  int  frameSkip   = -1; // default speed - 1
+  bool unthrottled = false;
+  bool stats       = false;
+  bool ntsc        = false;
+
+  std::string vgmFile;
+  std::string profileFile;
+  std::string labelsFile;
+  std::string traceFile;
 
   using Args = std::vector<std::string>;
 
@@ -22,8 +34,38 @@ main(int argc, char **argv)
     if (argv[i][0] == '-') {
       std::string arg = &argv[i][1];
 
-      if (arg == "D")
+      if      (arg == "D")
         debug = true;
+      else if (arg == "speed") {
+        if (i < argc - 1)
+          speed = std::max(std::atoi(argv[++i]), 1);
+      }
+      else if (arg == "frameskip") {
+        if (i < argc - 1)
+          frameSkip = std::max(std::atoi(argv[++i]), 0);
+      }
+      else if (arg == "unthrottled")
+        unthrottled = true;
+      else if (arg == "stats")
+        stats = true;
+      else if (arg == "ntsc")
+        ntsc = true;
+      else if (arg == "profile") {
+        if (i < argc - 1)
+          profileFile = argv[++i];
+      }
+      else if (arg == "labels") {
+        if (i < argc - 1)
+          labelsFile = argv[++i];
+      }
+      else if (arg == "trace") {
+        if (i < argc - 1)
+          traceFile = argv[++i];
+      }
+      else if (arg == "vgm") {
+        if (i < argc - 1)
+          vgmFile = argv[++i];
+      }
       else {
         std::cerr << "Invalid arg '" << argv[i] << "'\n";
         exit(1);
@@ -43,6 +85,20 @@ main(int argc, char **argv)
   if (debug)
     machine->setDebugWrite(true);
 
+  auto &pacer = machine->pacer();
+
+  if      (unthrottled)
+    pacer.setMode(Pacer::Mode::UNTHROTTLED);
+  else if (speed > 1) {
+    pacer.setMode (Pacer::Mode::FAST_FORWARD);
+    pacer.setSpeed(speed);
+  }
+
+  // only draw frames at display rate when fast forwarding
+  machine->getPPU()->setFrameSkip(frameSkip >= 0 ? frameSkip : speed - 1);
+
+  machine->getQPPU()->setNTSC(ntsc);
+
   auto file = machine->getCart();
 
   for (const auto &arg : args) {
@@ -57,12 +113,51 @@ main(int argc, char **argv)
 
   cpu->resetSystem();
 
-  while (true) {
+  if (vgmFile != "" && ! machine->startSoundLog(vgmFile))
+    std::cerr << "Failed to open '" << vgmFile << "'\n";
+
+  // trace always on, dumped on breakpoint or crash
+  if (traceFile != "") {
+    auto &trace = machine->trace();
+
+    trace.setEnabled(true);
+    trace.setDumpFile(traceFile);
+    trace.setDumpOnBreakpoint(true);
+    trace.installCrashHandler();
+  }
+
+  auto &profiler = machine->profiler();
+
+  if (labelsFile != "" && ! profiler.loadLabels(labelsFile))
+    std::cerr << "Failed to load '" << labelsFile << "'\n";
+
+  if (profileFile != "")
+    profiler.start();
+
+  while (machine->getQPPU()->isVisible()) {
     if (! cpu->isHalt())
-      cpu->step();
+      machine->runFrame();
+
+    CNES_STATS_TIMER(machine->stats(), EVENTS);
 
     qApp->processEvents();
   }
 
+  machine->stopSoundLog();
+
+  if (stats)
+    std::cout << machine->stats().toJSON();
+
+  // <file>.txt sorted report, <file>.folded collapsed stacks (flamegraph.pl)
+  if (profileFile != "") {
+    std::ofstream reportFile(profileFile + ".txt");
+
+    profiler.writeReport(reportFile);
+
+    std::ofstream foldedFile(profileFile + ".folded");
+
+    profiler.writeCollapsed(foldedFile);
+  }
+
   return 0;
 }
@@ -2,7 +2,7 @@ TEMPLATE = app
 
 TARGET = CQNESTest
 
-QT += widgets
+QT += widgets multimedia
 
 DEPENDPATH += .
 
@@ -11,6 +11,9 @@ QMAKE_CXXFLAGS += \
 
 MOC_DIR = .moc
 
+# instrumentation counters/timers (match core library build)
+#DEFINES += CNES_STATS
+
 SOURCES += \
 CQNESTest.cpp \
 
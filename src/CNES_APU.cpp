@@ -0,0 +1,795 @@
+#include <CNES_APU.h>
+#include <CNES_Machine.h>
+#include <CNES_CPU.h>
+#include <algorithm>
+#include <cassert>
+
+namespace CNES {
+
+namespace {
+
+const uchar s_lengthTable[32] = {
+  10, 254, 20,  2, 40,  4, 80,  6, 160,  8, 60, 10, 14, 12, 26, 14,
+  12,  16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+const uchar s_dutyTable[4][8] = {
+  { 0, 1, 0, 0, 0, 0, 0, 0 },
+  { 0, 1, 1, 0, 0, 0, 0, 0 },
+  { 0, 1, 1, 1, 1, 0, 0, 0 },
+  { 1, 0, 0, 1, 1, 1, 1, 1 }
+};
+
+const uchar s_triangleTable[32] = {
+  15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15
+};
+
+// NTSC periods in cpu cycles
+const ushort s_noiseTable[16] = {
+  4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+
+const ushort s_dmcTable[16] = {
+  428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+// frame sequencer step cycles (NTSC) for 4 and 5 step modes
+const ulong s_frameSteps4[4] = { 7457, 14913, 22371, 29829 };
+const ulong s_frameSteps5[5] = { 7457, 14913, 22371, 29829, 37281 };
+
+const ulong s_framePeriod4 = 29830;
+const ulong s_framePeriod5 = 37282;
+
+// output amplitude for full scale mixer output
+const float s_volume = 24000.0f;
+
+// max cycles between output buffer frames (keeps deltas within buffer)
+const ulong s_maxFrameCycles = 1789773/20;
+
+// non-linear mixer
+struct Mixer {
+  Mixer() {
+    pulse[0] = 0.0f;
+
+    for (int i = 1; i < 31; ++i)
+      pulse[i] = float(95.52/(8128.0/i + 100.0));
+
+    tnd[0] = 0.0f;
+
+    for (int i = 1; i < 203; ++i)
+      tnd[i] = float(163.67/(24329.0/i + 100.0));
+  }
+
+  float pulse[31];
+  float tnd[203];
+};
+
+const Mixer s_mixer;
+
+}
+
+//---
+
+const ulong APU::s_never;
+
+APU::
+APU(Machine *machine) :
+ machine_(machine)
+{
+  assert(machine_);
+
+  pulse_[0].ones = true;
+
+  reset();
+}
+
+APU::
+~APU()
+{
+}
+
+void
+APU::
+reset()
+{
+  pulse_[0] = Pulse(); pulse_[0].ones = true;
+  pulse_[1] = Pulse();
+  triangle_ = Triangle();
+  noise_    = Noise();
+  dmc_      = DMC();
+
+  frameMode5_      = false;
+  frameIRQInhibit_ = false;
+  frameIRQ_        = false;
+
+  time_ = cpuCycles();
+  amp_  = 0;
+
+  frameStep_  = 0;
+  frameStart_ = time_;
+  frameTime_  = frameStart_ + s_frameSteps4[0];
+
+  blip_.clear(time_);
+}
+
+void
+APU::
+setSampleRate(int rate)
+{
+  sync();
+
+  blip_.setRates(blip_.clockRate(), rate);
+}
+
+void
+APU::
+setClockRate(double rate)
+{
+  sync();
+
+  blip_.setRates(rate, blip_.sampleRate());
+}
+
+ulong
+APU::
+cpuCycles() const
+{
+  auto *cpu = machine_->getCPU();
+
+  return (cpu ? cpu->cycles() : 0);
+}
+
+//---
+
+void
+APU::
+setByte(ushort addr, uchar c)
+{
+  sync();
+
+  //---
+
+  // Pulse 1/2
+  if      (addr >= 0x4000 && addr <= 0x4007) {
+    auto &pulse = pulse_[(addr & 0x04) >> 2];
+
+    switch (addr & 0x03) {
+      case 0:
+        pulse.duty              = (c & 0xC0) >> 6;
+        pulse.envelope.loop     = (c & 0x20);
+        pulse.envelope.constant = (c & 0x10);
+        pulse.envelope.volume   = (c & 0x0F);
+        break;
+      case 1:
+        pulse.sweepEnabled = (c & 0x80);
+        pulse.sweepPeriod  = (c & 0x70) >> 4;
+        pulse.sweepNegate  = (c & 0x08);
+        pulse.sweepShift   = (c & 0x07);
+        pulse.sweepReload  = true;
+        break;
+      case 2:
+        pulse.timer = (pulse.timer & 0x0700) | c;
+        break;
+      case 3:
+        pulse.timer = (pulse.timer & 0x00FF) | ((c & 0x07) << 8);
+
+        if (pulse.enabled)
+          pulse.length = s_lengthTable[c >> 3];
+
+        pulse.pos            = 0;
+        pulse.envelope.start = true;
+        break;
+    }
+  }
+  // Triangle
+  else if (addr == 0x4008) {
+    triangle_.control    = (c & 0x80);
+    triangle_.linearLoad = (c & 0x7F);
+  }
+  else if (addr == 0x400A) {
+    triangle_.timer = (triangle_.timer & 0x0700) | c;
+  }
+  else if (addr == 0x400B) {
+    triangle_.timer = (triangle_.timer & 0x00FF) | ((c & 0x07) << 8);
+
+    if (triangle_.enabled)
+      triangle_.length = s_lengthTable[c >> 3];
+
+    triangle_.linearReload = true;
+  }
+  // Noise
+  else if (addr == 0x400C) {
+    noise_.envelope.loop     = (c & 0x20);
+    noise_.envelope.constant = (c & 0x10);
+    noise_.envelope.volume   = (c & 0x0F);
+  }
+  else if (addr == 0x400E) {
+    noise_.mode = (c & 0x80);
+    noise_.rate = (c & 0x0F);
+  }
+  else if (addr == 0x400F) {
+    if (noise_.enabled)
+      noise_.length = s_lengthTable[c >> 3];
+
+    noise_.envelope.start = true;
+  }
+  // DMC
+  else if (addr == 0x4010) {
+    dmc_.irqEnabled = (c & 0x80);
+    dmc_.loop       = (c & 0x40);
+    dmc_.rate       = (c & 0x0F);
+
+    if (! dmc_.irqEnabled)
+      dmc_.irq = false;
+  }
+  else if (addr == 0x4011) {
+    dmc_.level = (c & 0x7F);
+  }
+  else if (addr == 0x4012) {
+    dmc_.sampleAddr = 0xC000 + c*64;
+  }
+  else if (addr == 0x4013) {
+    dmc_.sampleLength = c*16 + 1;
+  }
+  // Status (channel enables)
+  else if (addr == 0x4015) {
+    pulse_[0].enabled = (c & 0x01);
+    pulse_[1].enabled = (c & 0x02);
+    triangle_.enabled = (c & 0x04);
+    noise_   .enabled = (c & 0x08);
+
+    if (! pulse_[0].enabled) pulse_[0].length = 0;
+    if (! pulse_[1].enabled) pulse_[1].length = 0;
+    if (! triangle_.enabled) triangle_.length = 0;
+    if (! noise_   .enabled) noise_   .length = 0;
+
+    if (c & 0x10) {
+      if (dmc_.bytesRemaining == 0) {
+        dmc_.addr           = dmc_.sampleAddr;
+        dmc_.bytesRemaining = dmc_.sampleLength;
+
+        // empty buffer is filled (by DMA) immediately
+        if (! dmc_.bufferFull)
+          dmc_.fetchTime = time_;
+      }
+    }
+    else {
+      dmc_.bytesRemaining = 0;
+      dmc_.fetchTime      = s_never;
+    }
+
+    dmc_.irq = false;
+  }
+  // Frame Counter
+  else if (addr == 0x4017) {
+    frameMode5_      = (c & 0x80);
+    frameIRQInhibit_ = (c & 0x40);
+
+    if (frameIRQInhibit_)
+      frameIRQ_ = false;
+
+    // restart sequence (5 step mode clocks immediately)
+    frameStep_  = 0;
+    frameStart_ = time_;
+    frameTime_  = frameStart_ + s_frameSteps4[0];
+
+    if (frameMode5_) {
+      clockQuarterFrame();
+      clockHalfFrame();
+    }
+  }
+
+  //---
+
+  schedule(time_);
+
+  updateOutput(time_);
+}
+
+uchar
+APU::
+getStatus()
+{
+  sync();
+
+  uchar c = peekStatus();
+
+  frameIRQ_ = false;
+
+  return c;
+}
+
+uchar
+APU::
+peekStatus() const
+{
+  uchar c = 0x00;
+
+  if (pulse_[0].length > 0) c |= 0x01;
+  if (pulse_[1].length > 0) c |= 0x02;
+  if (triangle_.length > 0) c |= 0x04;
+  if (noise_   .length > 0) c |= 0x08;
+
+  if (dmc_.bytesRemaining > 0) c |= 0x10;
+
+  if (frameIRQ_) c |= 0x40;
+  if (dmc_.irq ) c |= 0x80;
+
+  return c;
+}
+
+//---
+
+void
+APU::
+endFrame()
+{
+  sync();
+
+  blip_.endFrame(time_);
+}
+
+int
+APU::
+readSamples(short *out, int n)
+{
+  endFrame();
+
+  return blip_.readSamples(out, n);
+}
+
+//---
+
+// catch up to current cpu cycle
+void
+APU::
+sync()
+{
+  run(cpuCycles());
+}
+
+void
+APU::
+run(ulong time)
+{
+  if (time <= time_)
+    return;
+
+  // split into chunks which fit in output buffer
+  while (time_ < time) {
+    ulong time1 = std::min(time, blip_.frameTime() + s_maxFrameCycles);
+
+    runTo(time1);
+
+    if (time1 - blip_.frameTime() >= s_maxFrameCycles)
+      blip_.endFrame(time1);
+  }
+}
+
+// step channels from event to event until time
+void
+APU::
+runTo(ulong time)
+{
+  while (true) {
+    ulong t = frameTime_;
+
+    t = std::min(t, pulse_[0].nextTime);
+    t = std::min(t, pulse_[1].nextTime);
+    t = std::min(t, triangle_.nextTime);
+    t = std::min(t, noise_   .nextTime);
+    t = std::min(t, dmc_     .nextTime);
+    t = std::min(t, dmc_     .fetchTime);
+
+    if (t >= time)
+      break;
+
+    if (pulse_[0].nextTime == t) pulse_[0].step();
+    if (pulse_[1].nextTime == t) pulse_[1].step();
+    if (triangle_.nextTime == t) triangle_.step();
+    if (noise_   .nextTime == t) noise_   .step();
+    if (dmc_     .nextTime == t) stepDMC(t);
+
+    // DMC fetch (may be set by step at same time)
+    if (dmc_.fetchTime == t) {
+      dmc_.fetchTime = s_never;
+
+      fetchDMC();
+
+      schedule(t);
+    }
+
+    if (frameTime_ == t) {
+      clockFrame(t);
+
+      schedule(t);
+    }
+
+    updateOutput(t);
+  }
+
+  time_ = time;
+}
+
+//---
+
+void
+APU::
+clockFrame(ulong time)
+{
+  if (! frameMode5_) {
+    // 4 step: Q, QH, Q, QH + IRQ
+    clockQuarterFrame();
+
+    if (frameStep_ == 1 || frameStep_ == 3)
+      clockHalfFrame();
+
+    if (frameStep_ == 3 && ! frameIRQInhibit_)
+      frameIRQ_ = true;
+
+    if (++frameStep_ >= 4) {
+      frameStep_   = 0;
+      frameStart_ += s_framePeriod4;
+    }
+
+    frameTime_ = frameStart_ + s_frameSteps4[frameStep_];
+  }
+  else {
+    // 5 step: Q, QH, Q, -, QH
+    if (frameStep_ != 3)
+      clockQuarterFrame();
+
+    if (frameStep_ == 1 || frameStep_ == 4)
+      clockHalfFrame();
+
+    if (++frameStep_ >= 5) {
+      frameStep_   = 0;
+      frameStart_ += s_framePeriod5;
+    }
+
+    frameTime_ = frameStart_ + s_frameSteps5[frameStep_];
+  }
+
+  assert(frameTime_ > time);
+}
+
+// envelopes and triangle linear counter
+void
+APU::
+clockQuarterFrame()
+{
+  pulse_[0].envelope.clock();
+  pulse_[1].envelope.clock();
+  noise_   .envelope.clock();
+
+  triangle_.clockLinear();
+}
+
+// length counters and sweeps
+void
+APU::
+clockHalfFrame()
+{
+  auto clockLength = [](uchar &length, bool halt) {
+    if (! halt && length > 0)
+      --length;
+  };
+
+  clockLength(pulse_[0].length, pulse_[0].envelope.loop);
+  clockLength(pulse_[1].length, pulse_[1].envelope.loop);
+  clockLength(triangle_.length, triangle_.control);
+  clockLength(noise_   .length, noise_.envelope.loop);
+
+  pulse_[0].clockSweep();
+  pulse_[1].clockSweep();
+}
+
+//---
+
+void
+APU::
+stepDMC(ulong time)
+{
+  if (! dmc_.silence) {
+    if (dmc_.shift & 0x01) {
+      if (dmc_.level <= 125)
+        dmc_.level += 2;
+    }
+    else {
+      if (dmc_.level >= 2)
+        dmc_.level -= 2;
+    }
+
+    dmc_.shift >>= 1;
+  }
+
+  if (--dmc_.bitsRemaining == 0) {
+    dmc_.bitsRemaining = 8;
+
+    // start new output cycle from sample buffer
+    if (dmc_.bufferFull) {
+      dmc_.shift      = dmc_.buffer;
+      dmc_.bufferFull = false;
+      dmc_.silence    = false;
+
+      // buffer now empty so fetch next byte
+      if (dmc_.bytesRemaining > 0)
+        dmc_.fetchTime = time;
+    }
+    else
+      dmc_.silence = true;
+  }
+
+  dmc_.nextTime += dmc_.period();
+
+  if (! dmc_.isActive())
+    dmc_.nextTime = s_never;
+}
+
+// next fetch is pending or happens when output cycle takes the (full) buffer
+ulong
+APU::
+dmcFetchTime() const
+{
+  if (dmc_.fetchTime != s_never)
+    return dmc_.fetchTime;
+
+  if (! dmc_.bufferFull || dmc_.bytesRemaining == 0 || dmc_.nextTime == s_never)
+    return s_never;
+
+  return dmc_.nextTime + (dmc_.bitsRemaining - 1)*dmc_.period();
+}
+
+void
+APU::
+runDMCFetch(ulong time)
+{
+  run(time + 1);
+}
+
+// frame interrupt is raised by last step of 4 step sequence
+ulong
+APU::
+frameIRQTime() const
+{
+  if (frameMode5_ || frameIRQInhibit_ || frameIRQ_)
+    return s_never;
+
+  return frameStart_ + s_frameSteps4[3];
+}
+
+void
+APU::
+runFrameIRQ(ulong time)
+{
+  run(time + 1);
+}
+
+// fill sample buffer from memory
+void
+APU::
+fetchDMC()
+{
+  if (dmc_.bytesRemaining == 0 || dmc_.bufferFull)
+    return;
+
+  auto *cpu = machine_->getCPU();
+
+  dmc_.buffer     = cpu->getByte(dmc_.addr);
+  dmc_.bufferFull = true;
+
+  ++numDMCFetches_;
+
+  dmc_.addr = (dmc_.addr == 0xFFFF ? 0x8000 : dmc_.addr + 1);
+
+  if (--dmc_.bytesRemaining == 0) {
+    if      (dmc_.loop) {
+      dmc_.addr           = dmc_.sampleAddr;
+      dmc_.bytesRemaining = dmc_.sampleLength;
+    }
+    else if (dmc_.irqEnabled)
+      dmc_.irq = true;
+  }
+}
+
+//---
+
+// start/stop channel timers (inactive channels are not stepped)
+void
+APU::
+schedule(ulong time)
+{
+  auto scheduleChannel = [&](ulong &nextTime, bool active, ulong period) {
+    if      (! active)
+      nextTime = s_never;
+    else if (nextTime == s_never)
+      nextTime = time + period;
+  };
+
+  scheduleChannel(pulse_[0].nextTime, pulse_[0].isActive(), pulse_[0].period());
+  scheduleChannel(pulse_[1].nextTime, pulse_[1].isActive(), pulse_[1].period());
+  scheduleChannel(triangle_.nextTime, triangle_.isActive(), triangle_.period());
+  scheduleChannel(noise_   .nextTime, noise_   .isActive(), noise_   .period());
+  scheduleChannel(dmc_     .nextTime, dmc_     .isActive(), dmc_     .period());
+}
+
+// add band-limited step if mixed output changed
+void
+APU::
+updateOutput(ulong time)
+{
+  int p = pulse_[0].output() + pulse_[1].output();
+  int t = 3*triangle_.output() + 2*noise_.output() + dmc_.output();
+
+  int amp = int((s_mixer.pulse[p] + s_mixer.tnd[t])*s_volume);
+
+  if (amp != amp_) {
+    blip_.addDelta(time, float(amp - amp_));
+
+    amp_ = amp;
+  }
+}
+
+//---
+
+void
+APU::Envelope::
+clock()
+{
+  if (start) {
+    start   = false;
+    decay   = 15;
+    divider = volume;
+  }
+  else if (divider == 0) {
+    divider = volume;
+
+    if      (decay > 0)
+      --decay;
+    else if (loop)
+      decay = 15;
+  }
+  else
+    --divider;
+}
+
+//---
+
+int
+APU::Pulse::
+sweepTarget() const
+{
+  int change = timer >> sweepShift;
+
+  if (sweepNegate)
+    return timer - change - (ones ? 1 : 0);
+  else
+    return timer + change;
+}
+
+bool
+APU::Pulse::
+isMuted() const
+{
+  return (timer < 8 || sweepTarget() > 0x7FF);
+}
+
+bool
+APU::Pulse::
+isActive() const
+{
+  return (length > 0 && envelope.output() > 0 && ! isMuted());
+}
+
+uchar
+APU::Pulse::
+output() const
+{
+  if (! isActive())
+    return 0;
+
+  return (s_dutyTable[duty][pos] ? envelope.output() : 0);
+}
+
+void
+APU::Pulse::
+clockSweep()
+{
+  if (sweepDivider == 0 && sweepEnabled && sweepShift > 0 && ! isMuted())
+    timer = ushort(sweepTarget());
+
+  if (sweepDivider == 0 || sweepReload) {
+    sweepDivider = sweepPeriod;
+    sweepReload  = false;
+  }
+  else
+    --sweepDivider;
+}
+
+//---
+
+bool
+APU::Triangle::
+isActive() const
+{
+  // ultrasonic periods are not stepped (output held)
+  return (length > 0 && linear > 0 && timer >= 2);
+}
+
+uchar
+APU::Triangle::
+output() const
+{
+  return s_triangleTable[pos];
+}
+
+void
+APU::Triangle::
+clockLinear()
+{
+  if      (linearReload)
+    linear = linearLoad;
+  else if (linear > 0)
+    --linear;
+
+  if (! control)
+    linearReload = false;
+}
+
+//---
+
+bool
+APU::Noise::
+isActive() const
+{
+  return (length > 0 && envelope.output() > 0);
+}
+
+uchar
+APU::Noise::
+output() const
+{
+  if (! isActive() || (shift & 0x01))
+    return 0;
+
+  return envelope.output();
+}
+
+ulong
+APU::Noise::
+period() const
+{
+  return s_noiseTable[rate];
+}
+
+void
+APU::Noise::
+step()
+{
+  int bit = (mode ? 6 : 1);
+
+  ushort feedback = (shift & 0x01) ^ ((shift >> bit) & 0x01);
+
+  shift = (shift >> 1) | (feedback << 14);
+
+  nextTime += period();
+}
+
+//---
+
+bool
+APU::DMC::
+isActive() const
+{
+  return (! silence || bufferFull || bytesRemaining > 0 || bitsRemaining != 8);
+}
+
+ulong
+APU::DMC::
+period() const
+{
+  return s_dmcTable[rate];
+}
+
+}
@@ -0,0 +1,237 @@
+#include <CNES_AudioSink.h>
+#include <cstring>
+
+namespace CNES {
+
+RingAudioSink::
+RingAudioSink(int sampleRate, double maxLatency) :
+ AudioSink(sampleRate)
+{
+  capacity_ = std::max(uint(sampleRate*maxLatency), 64U);
+
+  ring_.resize(capacity_);
+}
+
+void
+RingAudioSink::
+writeSamples(const short *samples, int n)
+{
+  // limit to capacity (ring may be larger as rounded to power of two)
+  uint space = capacity_ - std::min(ring_.size(), capacity_);
+
+  uint n1 = ring_.write(samples, std::min(uint(n), space));
+
+  if (n1 < uint(n))
+    ++numOverruns_;
+}
+
+double
+RingAudioSink::
+fillLevel() const
+{
+  return double(ring_.size())/capacity_;
+}
+
+double
+RingAudioSink::
+latency() const
+{
+  return double(ring_.size())/sampleRate();
+}
+
+double
+RingAudioSink::
+maxLatency() const
+{
+  return double(capacity_)/sampleRate();
+}
+
+int
+RingAudioSink::
+readSamples(short *samples, int n)
+{
+  int n1 = int(ring_.read(samples, uint(n)));
+
+  if (n1 > 0)
+    lastSample_ = samples[n1 - 1];
+
+  if (n1 < n) {
+    ++numUnderruns_;
+
+    for (int i = n1; i < n; ++i)
+      samples[i] = lastSample_;
+  }
+
+  return n;
+}
+
+//---
+
+WavAudioSink::
+WavAudioSink(int sampleRate) :
+ AudioSink(sampleRate)
+{
+}
+
+WavAudioSink::
+~WavAudioSink()
+{
+  close();
+}
+
+bool
+WavAudioSink::
+open(const std::string &filename)
+{
+  close();
+
+  fp_ = fopen(filename.c_str(), "wb");
+  if (! fp_) return false;
+
+  numSamples_ = 0;
+  done_       = false;
+
+  // header is rewritten on close (when sizes are known)
+  writeHeader();
+
+  block_.reserve(s_blockSize);
+
+  thread_ = std::thread(&WavAudioSink::writeThread, this);
+
+  return true;
+}
+
+void
+WavAudioSink::
+close()
+{
+  if (! fp_)
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (! block_.empty()) {
+      blocks_.push_back(std::move(block_));
+
+      block_ = Block();
+    }
+
+    done_ = true;
+  }
+
+  cond_.notify_one();
+
+  thread_.join();
+
+  fseek(fp_, 0, SEEK_SET);
+
+  writeHeader();
+
+  fclose(fp_);
+
+  fp_ = nullptr;
+}
+
+void
+WavAudioSink::
+writeSamples(const short *samples, int n)
+{
+  if (! fp_)
+    return;
+
+  block_.insert(block_.end(), samples, samples + n);
+
+  numSamples_ += n;
+
+  if (block_.size() < s_blockSize)
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    blocks_.push_back(std::move(block_));
+  }
+
+  cond_.notify_one();
+
+  block_ = Block();
+
+  block_.reserve(s_blockSize);
+}
+
+void
+WavAudioSink::
+writeThread()
+{
+  while (true) {
+    Block block;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      cond_.wait(lock, [&]() { return done_ || ! blocks_.empty(); });
+
+      if (blocks_.empty())
+        break;
+
+      block = std::move(blocks_.front());
+
+      blocks_.pop_front();
+    }
+
+    // 16 bit little endian samples
+    std::vector<uchar> bytes(block.size()*2);
+
+    for (size_t i = 0; i < block.size(); ++i) {
+      bytes[2*i    ] = uchar( block[i]       & 0xFF);
+      bytes[2*i + 1] = uchar((block[i] >> 8) & 0xFF);
+    }
+
+    fwrite(&bytes[0], 1, bytes.size(), fp_);
+  }
+}
+
+// RIFF/WAVE header for mono 16 bit PCM
+void
+WavAudioSink::
+writeHeader()
+{
+  uint dataSize = uint(numSamples_*2);
+
+  uchar header[44];
+
+  auto setString = [&](int pos, const char *str) {
+    std::memcpy(&header[pos], str, 4);
+  };
+
+  auto setLong = [&](int pos, uint l) {
+    header[pos    ] = uchar( l        & 0xFF);
+    header[pos + 1] = uchar((l >>  8) & 0xFF);
+    header[pos + 2] = uchar((l >> 16) & 0xFF);
+    header[pos + 3] = uchar((l >> 24) & 0xFF);
+  };
+
+  auto setShort = [&](int pos, ushort s) {
+    header[pos    ] = uchar( s       & 0xFF);
+    header[pos + 1] = uchar((s >> 8) & 0xFF);
+  };
+
+  setString( 0, "RIFF");
+  setLong  ( 4, 36 + dataSize);
+  setString( 8, "WAVE");
+  setString(12, "fmt ");
+  setLong  (16, 16);                   // fmt chunk size
+  setShort (20, 1);                    // PCM
+  setShort (22, 1);                    // channels
+  setLong  (24, uint(sampleRate()));   // sample rate
+  setLong  (28, uint(sampleRate()*2)); // byte rate
+  setShort (32, 2);                    // block align
+  setShort (34, 16);                   // bits per sample
+  setString(36, "data");
+  setLong  (40, dataSize);
+
+  fwrite(header, 1, sizeof(header), fp_);
+}
+
+}
@@ -0,0 +1,161 @@
+#include <CNES_BlipBuffer.h>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace CNES {
+
+BlipBuffer::
+BlipBuffer()
+{
+  initKernel();
+
+  setRates(clockRate_, sampleRate_);
+}
+
+void
+BlipBuffer::
+setRates(double clockRate, int sampleRate)
+{
+  bool resize = (sampleRate != sampleRate_ || buffer_.empty());
+
+  clockRate_  = clockRate;
+  sampleRate_ = sampleRate;
+
+  factor_ = sampleRate_/clockRate_;
+
+  // dc blocker at ~37Hz (as NES output)
+  highPassR_ = float(1.0 - 2.0*M_PI*37.0/sampleRate_);
+
+  // 1/4 second of samples
+  if (resize) {
+    buffer_.resize(sampleRate_/4 + s_width);
+
+    clear(frameTime_);
+  }
+}
+
+void
+BlipBuffer::
+clear(ulong time)
+{
+  std::fill(buffer_.begin(), buffer_.end(), 0.0f);
+
+  frameTime_   = time;
+  offset_      = 0.0;
+  avail_       = 0;
+  integrator_  = 0.0f;
+  highPassIn_  = 0.0f;
+  highPassOut_ = 0.0f;
+}
+
+void
+BlipBuffer::
+initKernel()
+{
+  // windowed (blackman) sinc impulse with cutoff a little below nyquist,
+  // one per sub-sample phase, normalized to unit sum
+  const double cutoff = 0.9;
+
+  for (int ip = 0; ip < s_phases; ++ip) {
+    double frac = double(ip)/s_phases;
+
+    double sum = 0.0;
+
+    double h[s_width];
+
+    for (int ik = 0; ik < s_width; ++ik) {
+      double x = ik - s_width/2 + 1 - frac;
+
+      double sx = M_PI*x*cutoff;
+      double s  = (std::abs(sx) < 1E-9 ? 1.0 : std::sin(sx)/sx);
+
+      double wx = 2.0*M_PI*(x + s_width/2.0)/s_width;
+      double w  = 0.42 - 0.5*std::cos(wx) + 0.08*std::cos(2*wx);
+
+      h[ik] = s*w;
+
+      sum += h[ik];
+    }
+
+    for (int ik = 0; ik < s_width; ++ik)
+      kernel_[ip][ik] = float(h[ik]/sum);
+  }
+}
+
+void
+BlipBuffer::
+addDelta(ulong time, float delta)
+{
+  double pos = offset_ + double(time - frameTime_)*factor_;
+
+  int    i    = int(pos);
+  double frac = pos - i;
+
+  if (i < 0 || i + s_width > int(buffer_.size()))
+    return; // not drained (or time out of order) so drop
+
+  int ip = std::min(int(frac*s_phases), s_phases - 1);
+
+  const float *k = kernel_[ip];
+  float       *b = &buffer_[i];
+
+  for (int ik = 0; ik < s_width; ++ik)
+    b[ik] += k[ik]*delta;
+}
+
+void
+BlipBuffer::
+endFrame(ulong time)
+{
+  offset_ += double(time - frameTime_)*factor_;
+
+  frameTime_ = time;
+
+  // deltas only affect samples at or after their position, so all
+  // samples before the current position are complete
+  avail_ = int(offset_);
+
+  // discard oldest samples if not being read
+  int maxAvail = int(buffer_.size()) - 2*s_width;
+
+  if (avail_ > maxAvail)
+    readSamples(nullptr, avail_ - maxAvail);
+}
+
+int
+BlipBuffer::
+readSamples(short *out, int n)
+{
+  n = std::min(n, avail_);
+
+  if (n <= 0)
+    return 0;
+
+  for (int i = 0; i < n; ++i) {
+    integrator_ += buffer_[i];
+
+    // dc blocker
+    float y = integrator_ - highPassIn_ + highPassR_*highPassOut_;
+
+    highPassIn_  = integrator_;
+    highPassOut_ = y;
+
+    if (out)
+      out[i] = short(std::min(std::max(y, -32768.0f), 32767.0f));
+  }
+
+  // remove read samples
+  int nb = int(buffer_.size());
+
+  std::memmove(&buffer_[0], &buffer_[n], (nb - n)*sizeof(float));
+
+  std::fill(buffer_.begin() + (nb - n), buffer_.end(), 0.0f);
+
+  avail_  -= n;
+  offset_ -= n;
+
+  return n;
+}
+
+}
@@ -1,8 +1,11 @@
 #include <CNES_CPU.h>
 #include <CNES_Machine.h>
 #include <CNES_PPU.h>
+#include <CNES_APU.h>
 #include <CNES_Cartridge.h>
+#include <CNES_Input.h>
 #include <C6502.h>
+#include <algorithm>
 
 namespace CNES {
 
@@ -10,6 +13,8 @@ CPU::
 CPU(Machine *machine) :
  C6502(), machine_(machine)
 {
+  trace_ = &machine_->trace();
+
   // enable unsupported 6502 instructons
   setUnsupported(true);
 }
@@ -33,22 +38,47 @@ ppuGetByte(ushort addr) const
   return c;
 }
 
+uchar
+CPU::
+opcodeByte(ushort addr) const
+{
+  auto *cart = machine_->getCart();
+
+  uchar c;
+
+  if      (addr >= 0xC000) {
+    if (cart->getUpperROMByte(addr - 0xC000, c))
+      return c;
+  }
+  else if (addr >= 0x8000) {
+    if (cart->getLowerROMByte(addr - 0x8000, c))
+      return c;
+  }
+  else if (addr <= 0x1FFF)
+    addr &= 0x07FF;
+
+  return C6502::getByte(addr);
+}
+
 uchar
 CPU::
 getByte(ushort addr) const
 {
   // 2kB Internal RAM, mirrored 4 times
   if      (addr <= 0x1FFF) {
+    CNES_STATS_COUNT(machine_->stats(), READ_RAM);
+
     uchar c = C6502::getByte(addr & 0x07FF);
 
-    if (isDebugRead() && ! in_ppu_ && ! isDebugger())
-      std::cerr << "CPU::getByte (Internal RAM) " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    if (! in_ppu_ && ! isDebugger())
+      trace(Trace::Kind::RAM_READ, addr, c, isDebugRead());
 
     return c;
   }
   // Input/Output
   else if (addr >= 0x2000 && addr <= 0x4FFF) {
+    CNES_STATS_COUNT(machine_->stats(), READ_IO);
+
     uchar c = 0x00;
 
     // PPU Control registers
@@ -58,76 +88,71 @@ getByte(ushort addr) const
       c = ppu->getControlByte(addr);
     }
     // Joystick 1 + Strobe
-    else if (addr == 0x4016) {
-      if (! isDebugger()) {
-        auto *ppu = machine_->getPPU();
+    // Joystick 2
+    else if (addr == 0x4016 || addr == 0x4017) {
+      auto &input = machine_->input();
 
-        c = 0x40;
+      int i = addr - 0x4016;
 
-        if (ppu->isKey1(keyNum1_))
-          c |= 0x01;
+      // upper bits are open bus (last byte on bus is usually high byte of address)
+      c = 0x40;
 
-        keyNum1_ = ((keyNum1_ + 1) & 0x07);
+      if (! isDebugger()) {
+        c |= input.read(i);
+
+        joyRead_ = i;
       }
       else
-        c = C6502::getByte(addr);
+        c |= input.peek(i);
     }
-    // Joystick 2
-    else if (addr == 0x4017) {
-      // Not connected
-      if (! isDebugger()) {
-#if 0
-        auto *ppu = machine_->getPPU();
-
-        c = 0x40;
-
-        if (ppu->isKey2(keyNum2_))
-          c |= 0x01;
+    // Sound Status
+    else if (addr == 0x4015) {
+      auto *apu = machine_->getAPU();
 
-        keyNum2_ = ((keyNum2_ + 1) & 0x07);
+      // read clears frame interrupt
+      if (! isDebugger()) {
+        c = apu->getStatus();
 
-        if (isDebugRead() && ! in_ppu_)
-          std::cerr << "CPU::getPPUByte " <<
-             std::hex << addr << " " << std::hex << int(c) << "\n";
-#else
-        c = 0x42;
-#endif
+        updateIRQ();
       }
       else
-        c = C6502::getByte(addr);
+        c = apu->peekStatus();
     }
     else {
       c = C6502::getByte(addr);
     }
 
-    if (isDebugRead() && ! in_ppu_ && ! isDebugger())
-      std::cerr << "CPU::getPPUByte " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    if (! in_ppu_ && ! isDebugger())
+      trace(Trace::Kind::IO_READ, addr, c, isDebugRead());
 
     return c;
   }
   // Expansion Modules
   else if (addr >= 0x5000 && addr <= 0x5FFF) {
+    CNES_STATS_COUNT(machine_->stats(), READ_EXPANSION);
+
     uchar c = C6502::getByte(addr);
 
-    if (isDebugRead() && ! in_ppu_ && ! isDebugger())
-      std::cerr << "CPU::getByte (Expansion Module) " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    if (! in_ppu_ && ! isDebugger())
+      trace(Trace::Kind::EXPANSION_READ, addr, c, isDebugRead());
 
     return c;
   }
   // Cartridge RAM (may be battery-backed)
   else if (addr >= 0x6000 && addr <= 0x7FFF) {
+    CNES_STATS_COUNT(machine_->stats(), READ_CART_RAM);
+
     uchar c = C6502::getByte(addr);
 
-    if (isDebugRead() && ! in_ppu_ && ! isDebugger())
-      std::cerr << "CPU::getByte (Cartridge RAM) " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    if (! in_ppu_ && ! isDebugger())
+      trace(Trace::Kind::CART_RAM_READ, addr, c, isDebugRead());
 
     return c;
   }
   // Lower Bank of Cartridge ROM (16k)
   else if (addr >= 0x8000 && addr <= 0xBFFF) {
+    CNES_STATS_COUNT(machine_->stats(), READ_ROM);
+
     auto *cart = machine_->getCart();
 
     uchar c;
@@ -136,10 +161,15 @@ getByte(ushort addr) const
     if (! cart->getLowerROMByte(addr - 0x8000, c))
       c = C6502::getByte(addr);
 
+    if (! in_ppu_ && ! isDebugger())
+      trace(Trace::Kind::ROM_READ, addr, c, cart->isDebugRead());
+
     return c;
   }
   // Upper Bank of Cartridge ROM (16k)
   else if (addr >= 0xC000) {
+    CNES_STATS_COUNT(machine_->stats(), READ_ROM);
+
     auto *cart = machine_->getCart();
 
     uchar c;
@@ -148,6 +178,9 @@ getByte(ushort addr) const
     if (! cart->getUpperROMByte(addr - 0xC000, c))
       c = C6502::getByte(addr);
 
+    if (! in_ppu_ && ! isDebugger())
+      trace(Trace::Kind::ROM_READ, addr, c, cart->isDebugRead());
+
     return c;
   }
   else {
@@ -162,17 +195,27 @@ setByte(ushort addr, uchar c)
 {
   // 2kB Internal RAM, mirrored 4 times
   if      (addr <= 0x1FFF) {
-    if (isDebugWrite() && ! isDebugger())
-      std::cerr << "CPU::setByte (Internal RAM) " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    CNES_STATS_COUNT(machine_->stats(), WRITE_RAM);
+
+    if (! isDebugger())
+      trace(Trace::Kind::RAM_WRITE, addr, c, isDebugWrite());
 
     addr &= 0x7FF;
   }
   // Input/Output
   else if (addr >= 0x2000 && addr <= 0x4FFF) {
-    if (isDebugWrite() && ! isDebugger())
-      std::cerr << "CPU::setByte (Input/Output) " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    CNES_STATS_COUNT(machine_->stats(), WRITE_IO);
+
+    if (! isDebugger()) {
+      // APU registers recorded once as APU writes (echoed if cpu or apu write debug)
+      if ((addr >= 0x4000 && addr <= 0x4013) || addr == 0x4015 || addr == 0x4017) {
+        auto *apu = machine_->getAPU();
+
+        trace(Trace::Kind::APU_WRITE, addr, c, isDebugWrite() || apu->isDebugWrite());
+      }
+      else
+        trace(Trace::Kind::IO_WRITE, addr, c, isDebugWrite());
+    }
 
     // PPU Control registers
     if      (addr >= 0x2000 && addr <= 0x2007) {
@@ -187,32 +230,14 @@ setByte(ushort addr, uchar c)
 
     // Sound
     else if (addr >= 0x4000 && addr <= 0x4013) {
-      // TODO
-#if 0
-      if      (addr == 0x4000) sq1Vol_    = c;
-      else if (addr == 0x4001) sq1Sweep_  = c;
-      else if (addr == 0x4002) sq1Lo_     = c;
-      else if (addr == 0x4003) sq1Hi_     = c;
-      else if (addr == 0x4004) sq2Vol_    = c;
-      else if (addr == 0x4005) sq2Sweep_  = c;
-      else if (addr == 0x4006) sq2Lo_     = c;
-      else if (addr == 0x4007) sq2Hi_     = c;
-      else if (addr == 0x4008) triLinear_ = c;
-//    else if (addr == 0x4009) { } // unused
-      else if (addr == 0x400a) triLo_     = c;
-      else if (addr == 0x400b) triHi_     = c;
-      else if (addr == 0x400c) noiseVol_  = c;
-//    else if (addr == 0x400d) { } // unused
-      else if (addr == 0x400e) noiseLo_   = c;
-      else if (addr == 0x400f) noiseHi_   = c;
-      else if (addr == 0x4010) dmcFreq_   = c;
-      else if (addr == 0x4011) dmcRaw_    = c;
-      else if (addr == 0x4012) dmcStart_  = c;
-      else if (addr == 0x4013) dmcLen_    = c;
-#endif
-      if (! isDebugger())
-        std::cerr << "CPU::setByte (Sound) " <<
-          std::hex << addr << " " << std::hex << int(c) << "\n";
+      auto *apu = machine_->getAPU();
+
+      apu->setByte(addr, c);
+
+      updateDMCFetchTime();
+      updateIRQ();
+
+      machine_->soundLog().log(cycles_, addr, c);
     }
     // DMA Access to the Sprite Memory (OAMDMA)
     else if (addr == 0x4014) {
@@ -220,58 +245,90 @@ setByte(ushort addr, uchar c)
 
       ppu->copySpriteMem(c);
 
+      // DMC fetches during OAM DMA only stall for 2 cycles
+      oamDMA_ = true;
+
       tick(255); tick(255); tick(3); // 513 or 514 ?
+
+      oamDMA_ = false;
     }
     // Sound Switch
     else if (addr == 0x4015) {
-      // TODO
-      //soundEnabled_[0] = (c & 0x01);
-      //soundEnabled_[1] = (c & 0x02);
-      //soundEnabled_[2] = (c & 0x04);
-      //soundEnabled_[3] = (c & 0x08);
-      //soundEnabled_[4] = (c & 0x10);
+      auto *apu = machine_->getAPU();
+
+      apu->setByte(addr, c);
+
+      updateDMCFetchTime();
+      updateIRQ();
+
+      machine_->soundLog().log(cycles_, addr, c);
     }
-    // Joystick 1 + Strobe
+    // Joystick 1 + 2 Strobe
     else if (addr == 0x4016) {
-      // TODO
-      if (c == 0)
-        keyNum1_ = 0;
+      auto &input = machine_->input();
+
+      input.setStrobe(c);
     }
-    // Joystick 2
+    // APU Frame Counter
     else if (addr == 0x4017) {
-      // TODO
-      if (c == 0)
-        keyNum2_ = 0;
+      auto *apu = machine_->getAPU();
+
+      apu->setByte(addr, c);
+
+      updateDMCFetchTime();
+      updateIRQ();
+
+      machine_->soundLog().log(cycles_, addr, c);
     }
     else if (addr >= 0x4018 && addr <= 0x401F) {
       // APU and I/O functionality that is normally disabled.
     }
 
-    signalNesChanged();
+    nesChanged_ = true;
   }
   // Expansion Modules
   else if (addr >= 0x5000 && addr <= 0x5FFF) {
-    if (isDebugWrite() && ! isDebugger())
-      std::cerr << "CPU::setByte (Expansion Modules) " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    CNES_STATS_COUNT(machine_->stats(), WRITE_EXPANSION);
+
+    if (! isDebugger())
+      trace(Trace::Kind::EXPANSION_WRITE, addr, c, isDebugWrite());
+
+    // NSF bank switch
+    if (addr >= 0x5FF8) {
+      auto *cart = machine_->getCart();
+
+      if (cart->isNSF())
+        cart->setNSFBank(addr - 0x5FF8, c);
+    }
   }
   // Cartridge RAM (may be battery-backed)
   else if (addr >= 0x6000 && addr <= 0x7FFF) {
-    if (isDebugWrite() && ! isDebugger())
-      std::cerr << "CPU::setByte (Cartridge RAM) " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    CNES_STATS_COUNT(machine_->stats(), WRITE_CART_RAM);
+
+    if (! isDebugger())
+      trace(Trace::Kind::CART_RAM_WRITE, addr, c, isDebugWrite());
   }
   // Lower Bank of Cartridge ROM
   else if (addr >= 0x8000 && addr <= 0xBFFF) {
+    CNES_STATS_COUNT(machine_->stats(), WRITE_ROM);
+
     auto *cart = machine_->getCart();
 
+    if (! isDebugger())
+      trace(Trace::Kind::ROM_WRITE, addr, c, cart->isDebugWrite());
+
     if (cart->setROMByte(addr - 0x8000, c))
       return;
   }
   // Upper Bank of Cartridge ROM
   else if (addr >= 0xC000) {
+    CNES_STATS_COUNT(machine_->stats(), WRITE_ROM);
+
     auto *cart = machine_->getCart();
 
+    if (! isDebugger())
+      trace(Trace::Kind::ROM_WRITE, addr, c, cart->isDebugWrite());
+
     if (cart->setROMByte(addr - 0xC000, c))
       return;
   }
@@ -279,6 +336,25 @@ setByte(ushort addr, uchar c)
   C6502::setByte(addr, c);
 }
 
+void
+CPU::
+breakpointHit()
+{
+  if (trace_->isDumpOnBreakpoint())
+    trace_->dump();
+}
+
+void
+CPU::
+flushChanges()
+{
+  if (nesChanged_) {
+    nesChanged_ = false;
+
+    signalNesChanged();
+  }
+}
+
 void
 CPU::
 memset(ushort addr, const uchar *data, ushort len)
@@ -290,9 +366,116 @@ void
 CPU::
 tick(uchar n)
 {
+  cycles_ += n;
+
+  // joystick read is on last cycle of instruction (absolute load)
+  if (joyRead_ >= 0)
+    joyReadTime_ = cycles_ - 1;
+
+  ulong stall = 0;
+
+  // DMC fetch due in this tick (cheap compare as fetch time is cached)
+  if (cycles_ > dmcFetchTime_)
+    stall = dmcFetch();
+
+  // frame interrupt due in this tick (cached time)
+  if (cycles_ > irqTime_) {
+    auto *apu = machine_->getAPU();
+
+    apu->runFrameIRQ(irqTime_);
+
+    updateIRQ();
+  }
+
+  joyRead_ = -1;
+
+  // profiler sample due (cached deadline)
+  auto &profiler = machine_->profiler();
+
+  if (cycles_ >= profiler.sampleTime())
+    profiler.sample(cycles_, PC());
+
   auto *ppu = machine_->getPPU();
 
   ppu->tick(n);
+
+  while (stall > 0) {
+    uchar n1 = uchar(std::min(stall, ulong(255)));
+
+    ppu->tick(n1);
+
+    stall -= n1;
+  }
+}
+
+// perform DMC fetches due before current cycle and charge their stall cycles.
+// The stall is applied after the instruction which was executing at the fetch time.
+ulong
+CPU::
+dmcFetch()
+{
+  auto *apu = machine_->getAPU();
+
+  ulong stall = 0;
+
+  while (cycles_ > dmcFetchTime_) {
+    ulong time = dmcFetchTime_;
+
+    apu->runDMCFetch(time);
+
+    // halt, dummy and alignment cycles (reduced when interleaved with OAM DMA)
+    ulong n = (oamDMA_ ? 2 : 4);
+
+    // halt on the joystick read cycle repeats the read (extra shift of register)
+    if (joyRead_ >= 0 && time == joyReadTime_) {
+      auto &input = machine_->input();
+
+      (void) input.read(joyRead_);
+
+      joyRead_ = -1;
+    }
+
+    cycles_ += n;
+    stall   += n;
+
+    dmcFetchTime_ = apu->dmcFetchTime();
+  }
+
+  dmcStallCycles_ += stall;
+
+  // last sample byte fetched may raise DMC interrupt
+  updateIRQ();
+
+  return stall;
+}
+
+void
+CPU::
+updateDMCFetchTime()
+{
+  auto *apu = machine_->getAPU();
+
+  dmcFetchTime_ = apu->dmcFetchTime();
+}
+
+void
+CPU::
+updateIRQ() const
+{
+  auto *apu = machine_->getAPU();
+
+  irq_     = apu->isIRQ();
+  irqTime_ = apu->frameIRQTime();
+}
+
+// IRQ is level triggered so it is taken each instruction until source is cleared
+// ($4015 read, $4017 write with inhibit, $4010 or $4015 write for DMC)
+void
+CPU::
+pollIRQ()
+{
+  if (irq_ && ! isIFlag())
+    resetIRQ();
 }
 
 bool
@@ -0,0 +1,35 @@
+#include <CNES_CRC.h>
+#include <vector>
+
+namespace CNES {
+
+uint
+crc32(const uchar *data, size_t len, uint crc)
+{
+  using Table = std::vector<uint>;
+
+  // built once (thread safe static init, can be called from parallel machines)
+  static const Table table = []() {
+    Table table(256);
+
+    for (uint i = 0; i < 256; ++i) {
+      uint c = i;
+
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1);
+
+      table[i] = c;
+    }
+
+    return table;
+  }();
+
+  crc = ~crc;
+
+  for (size_t i = 0; i < len; ++i)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+}
@@ -2,6 +2,7 @@
 #include <CNES_Machine.h>
 #include <CNES_CPU.h>
 #include <CNES_PPU.h>
+#include <CNES_CRC.h>
 #include <cstring>
 #include <cassert>
 
@@ -35,33 +36,30 @@ load(const std::string &filename)
 
   std::string suffix = toLower(filename.substr(p));
 
-  if (suffix != "nes")
-    return loadNES(filename);
+  if (suffix == ".nsf")
+    return loadNSF(filename);
   else
-    return false;
+    return loadNES(filename);
 }
 
 bool
 Cartridge::
 loadNES(const std::string &filename)
 {
-  struct File {
-    File(const std::string &filename) {
-      fp = fopen(filename.c_str(), "r");
-    }
-
-   ~File() {
-      if (fp)
-        fclose(fp);
-    }
+  Data data;
 
-    FILE *fp { nullptr };
-  };
+  if (! readFile(filename, data))
+    return false;
 
-  File file(filename);
-  if (! file.fp) return false;
+  return loadNESData(data);
+}
 
-  //---
+// load NES file contents
+bool
+Cartridge::
+loadNESData(const std::vector<uchar> &fileData)
+{
+  size_t pos = 0;
 
   auto initData = [&](std::vector<uchar> &data, ushort n) {
     data.resize(n);
@@ -69,17 +67,15 @@ loadNES(const std::string &filename)
     std::memset(&data[0], 0, n*sizeof(uchar));
   };
 
+  // read next n bytes of file data
   auto readData = [&](std::vector<uchar> &data, ushort &n) {
-    static uchar buffer[65526];
-
     if (n == 0) return true;
 
-    ushort n1 = fread(buffer, 1, n, file.fp);
-    if (n1 != n) { n = 0; return false; }
+    if (pos + n > fileData.size()) { n = 0; return false; }
 
-    data.resize(n);
+    data.assign(fileData.begin() + pos, fileData.begin() + pos + n);
 
-    std::memcpy(&data[0], buffer, n*sizeof(uchar));
+    pos += n;
 
     return true;
   };
@@ -201,16 +197,277 @@ loadNES(const std::string &filename)
       return false;
   }
 
+  isNSF_ = false;
+
+  // power on mapper state
+  mapper1Data_ = Mapper1Data();
+
+  chrChanged();
+
+  updateMirroring();
+
+  // ROM identity (PRG and CHR data, header excluded)
+  crc_ = crc32(prgRomData_.data(), prgRomData_.size());
+  crc_ = crc32(chrRomData_.data(), chrRomData_.size(), crc_);
+
   updateState();
 
+  machine_->cartridgeLoaded();
+
   return true;
 }
 
+// set ppu name table mirroring from header (or mapper state)
+void
+Cartridge::
+updateMirroring()
+{
+  auto *ppu = machine_->getPPU();
+  if (! ppu) return;
+
+  using Mirroring = PPU::Mirroring;
+
+  if      (ignoreMirror_)
+    ppu->setMirroring(Mirroring::FOUR_SCREEN);
+  else if (mapper_ == 1 && mapper1Data_.mirrorSet) {
+    static const Mirroring mapper1Mirroring[4] = {
+      Mirroring::SINGLE_A, Mirroring::SINGLE_B, Mirroring::VERTICAL, Mirroring::HORIZONTAL
+    };
+
+    ppu->setMirroring(mapper1Mirroring[mapper1Data_.mirror & 0x03]);
+  }
+  else
+    ppu->setMirroring(mirroring_ ? Mirroring::VERTICAL : Mirroring::HORIZONTAL);
+}
+
+// read whole file
+bool
+Cartridge::
+readFile(const std::string &filename, Data &data)
+{
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (! fp) return false;
+
+  uchar buffer[4096];
+
+  size_t n;
+
+  while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+
+  fclose(fp);
+
+  return true;
+}
+
+// load NES Sound Format file
+bool
+Cartridge::
+loadNSF(const std::string &filename)
+{
+  Data data;
+
+  if (! readFile(filename, data))
+    return false;
+
+  //---
+
+  static const uint s_headerSize = 0x80;
+
+  if (data.size() <= s_headerSize)
+    return false;
+
+  // String "NESM^Z" used to recognize .NSF files
+  if (data[0] != 0x4e || data[1] != 0x45 || data[2] != 0x53 ||
+      data[3] != 0x4d || data[4] != 0x1a)
+    return false;
+
+  auto getWord = [&](uint pos) {
+    return ushort(data[pos] | (data[pos + 1] << 8));
+  };
+
+  auto getString = [&](uint pos) {
+    std::string str;
+
+    for (uint i = 0; i < 32 && data[pos + i]; ++i)
+      str += char(data[pos + i]);
+
+    return str;
+  };
+
+  NSFData nsfData;
+
+  nsfData.numSongs  = data[0x06];
+  nsfData.startSong = data[0x07];
+  nsfData.loadAddr  = getWord(0x08);
+  nsfData.initAddr  = getWord(0x0A);
+  nsfData.playAddr  = getWord(0x0C);
+  nsfData.name      = getString(0x0E);
+  nsfData.artist    = getString(0x2E);
+  nsfData.copyright = getString(0x4E);
+  nsfData.speed     = getWord(0x6E);
+  nsfData.pal       = (data[0x7A] & 0x03) == 0x01;
+  nsfData.extraChips = data[0x7B];
+
+  for (int i = 0; i < 8; ++i) {
+    nsfData.banks[i] = data[0x70 + i];
+
+    if (nsfData.banks[i])
+      nsfData.bankSwitched = true;
+  }
+
+  if (nsfData.loadAddr < 0x8000)
+    return false;
+
+  //---
+
+  // program data is split into 4K banks. If bank switched the load address
+  // is the offset in the first bank, otherwise data is loaded at that address.
+  uint pad = (nsfData.bankSwitched ? nsfData.loadAddr & 0x0FFF : nsfData.loadAddr - 0x8000);
+
+  uint size = pad + uint(data.size() - s_headerSize);
+
+  size = (size + 0x0FFF) & ~0x0FFF;
+
+  nsfRomData_.clear();
+  nsfRomData_.resize(size, 0);
+
+  std::copy(data.begin() + s_headerSize, data.end(), nsfRomData_.begin() + pad);
+
+  if (! nsfData.bankSwitched) {
+    for (int i = 0; i < 8; ++i)
+      nsfData.banks[i] = uchar(i);
+  }
+
+  nsfData_ = nsfData;
+
+  for (int i = 0; i < 8; ++i)
+    nsfBanks_[i] = nsfData_.banks[i];
+
+  isNSF_ = true;
+
+  // no character data, PRG RAM at $6000-$7FFF
+  romCount_ = 0;
+  prgSize_  = 0;
+  chrCount_ = 0;
+  chrSize_  = 0;
+  mapper_   = 0;
+
+  hasPrgRam_  = true;
+  prgRamSize_ = 8192;
+
+  chrRomData_.clear();
+
+  chrChanged();
+
+  // ROM identity (NSF data, header excluded)
+  crc_ = crc32(&data[s_headerSize], data.size() - s_headerSize);
+
+  updateState();
+
+  machine_->cartridgeLoaded();
+
+  return true;
+}
+
+// byte at offset (from $8000) in bank switched NSF program data
+uchar
+Cartridge::
+getNSFByte(ushort addr) const
+{
+  static const ushort s_driverAddr = 0x4100;
+
+  // vectors point at player driver (NMI calls play, reset calls init)
+  switch (addr) {
+    case 0x7FFA: return uchar((s_driverAddr + 0x0F) & 0xFF); // NMI
+    case 0x7FFB: return uchar((s_driverAddr + 0x0F) >> 8);
+    case 0x7FFC: return uchar( s_driverAddr         & 0xFF); // RESET
+    case 0x7FFD: return uchar( s_driverAddr         >> 8);
+    case 0x7FFE: return uchar((s_driverAddr + 0x12) & 0xFF); // IRQ
+    case 0x7FFF: return uchar((s_driverAddr + 0x12) >> 8);
+    default: break;
+  }
+
+  uint numBanks = uint(nsfRomData_.size() >> 12);
+
+  uint bank = nsfBanks_[addr >> 12];
+
+  if (bank >= numBanks)
+    return 0;
+
+  return nsfRomData_[(bank << 12) | (addr & 0x0FFF)];
+}
+
+// set NSF bank (write to $5FF8-$5FFF)
+void
+Cartridge::
+setNSFBank(int i, uchar bank)
+{
+  if (nsfData_.bankSwitched)
+    nsfBanks_[i & 7] = bank;
+}
+
+// setup machine to play NSF song (1 based, 0 for start song). The driver at $4100
+// calls init with the song number and then enables the vblank NMI which calls play.
+void
+Cartridge::
+initNSF(int song)
+{
+  if (! isNSF_)
+    return;
+
+  if (song <= 0 || song > nsfData_.numSongs)
+    song = nsfData_.startSong;
+
+  auto *cpu = machine_->getCPU();
+
+  // clear RAM
+  std::vector<uchar> zeros(0x2000, 0);
+
+  cpu->memset(0x0000, &zeros[0], 0x0800);
+  cpu->memset(0x6000, &zeros[0], 0x2000);
+
+  // initial banks
+  for (int i = 0; i < 8; ++i)
+    nsfBanks_[i] = nsfData_.banks[i];
+
+  // silence sound registers
+  for (ushort addr = 0x4000; addr <= 0x4013; ++addr)
+    cpu->setByte(addr, 0x00);
+
+  cpu->setByte(0x4015, 0x00);
+  cpu->setByte(0x4015, 0x0F);
+  cpu->setByte(0x4017, 0x40);
+
+  //---
+
+  ushort init = nsfData_.initAddr;
+  ushort play = nsfData_.playAddr;
+
+  uchar driver[] = {
+    0xA9, uchar(song - 1),                      // 4100: LDA #song
+    0xA2, uchar(nsfData_.pal ? 1 : 0),          // 4102: LDX #pal
+    0x20, uchar(init & 0xFF), uchar(init >> 8), // 4104: JSR init
+    0xA9, 0x80,                                 // 4107: LDA #$80
+    0x8D, 0x00, 0x20,                           // 4109: STA $2000 (enable vblank NMI)
+    0x4C, 0x0C, 0x41,                           // 410C: JMP $410C
+    0x20, uchar(play & 0xFF), uchar(play >> 8), // 410F: JSR play (NMI)
+    0x40                                        // 4112: RTI
+  };
+
+  cpu->memset(0x4100, driver, sizeof(driver));
+}
+
 // Cartridge Lower ROM (mapped to $8000-$BFFF)
 bool
 Cartridge::
 getLowerROMByte(ushort addr, uchar &c) const
 {
+  if (isNSF_) {
+    c = getNSFByte(addr);
+    return true;
+  }
+
   if (romCount_ < 2)
     return false;
 
@@ -218,12 +475,6 @@ getLowerROMByte(ushort addr, uchar &c) const
 
   c = prgRomData_[addr];
 
-  auto cpu = machine_->getCPU();
-
-  if (isDebugRead() && ! cpu->isDebugger())
-    std::cerr << "Cartridge::getLowerROMByte " <<
-      std::hex << addr << " " << std::hex << int(c) << "\n";
-
   return true;
 }
 
@@ -232,6 +483,11 @@ bool
 Cartridge::
 getUpperROMByte(ushort addr, uchar &c) const
 {
+  if (isNSF_) {
+    c = getNSFByte(addr + 0x4000);
+    return true;
+  }
+
   if (romCount_ < 1)
     return false;
 
@@ -242,13 +498,26 @@ getUpperROMByte(ushort addr, uchar &c) const
 
   c = prgRomData_[addr];
 
-  auto cpu = machine_->getCPU();
+  return true;
+}
 
-  if (isDebugRead() && ! cpu->isDebugger())
-    std::cerr << "Cartridge::getUpperROMByte " <<
-      std::hex << addr << " " << std::hex << int(c) << "\n";
+int
+Cartridge::
+prgBank(ushort addr) const
+{
+  if (addr < 0x8000)
+    return -1;
 
-  return true;
+  if (isNSF_)
+    return nsfBanks_[(addr - 0x8000) >> 12];
+
+  if (addr < 0xC000)
+    return (romCount_ >= 2 ? 0 : -1);
+
+  if (romCount_ < 1)
+    return -1;
+
+  return (romCount_ >= 2 ? 1 : 0);
 }
 
 bool
@@ -257,17 +526,17 @@ setROMByte(ushort addr, uchar c)
 {
   auto cpu = machine_->getCPU();
 
-  if (isDebugWrite() && ! cpu->isDebugger())
-    std::cerr << "Cartridge::setROMByte " <<
-      std::hex << addr << " " << std::hex << int(c) << "\n";
-
-  if      (mapper_ == 1) {
+  if      (isNSF_) {
+    // NSF ROM is read only (banks are set at $5FF8-$5FFF)
+    return true;
+  }
+  else if (mapper_ == 1) {
     if (c & 0x80) {
       mapper1Data_.regBit   = 0;
       mapper1Data_.regValue = 0;
 
-      if (isDebugWrite())
-        std::cerr << "Cartridge::setROMByte : reset mapper\n";
+      // reset mapper
+      cpu->trace(Trace::Kind::MAPPER_WRITE, addr, c, isDebugWrite());
     }
     else {
       uchar b = c & 0x01;
@@ -290,6 +559,10 @@ setROMByte(ushort addr, uchar c)
 
         mapper1Data_.regData[regNum] = mapper1Data_.regValue;
 
+        uchar mirror    = mapper1Data_.mirror;
+        uchar vromBank0 = mapper1Data_.vromBank[0];
+        uchar vromBank1 = mapper1Data_.vromBank[1];
+
         //---
 
         // 0: one-screen, lower bank (nametable 0)
@@ -298,6 +571,9 @@ setROMByte(ushort addr, uchar c)
         // 3: horizontal mirror
         mapper1Data_.mirror = mapper1Data_.regData[0] & 0x03;
 
+        if (regNum == 0)
+          mapper1Data_.mirrorSet = true;
+
         // PRG ROM swap bank
         //  0 - Bank 8000-BFFFh is fixed, while C000-FFFFh is swappable
         //  1 - Bank C000-FFFFh is fixed, while 8000-FFFFh is swappable. (power-on default)
@@ -339,14 +615,19 @@ setROMByte(ushort addr, uchar c)
         //     (low bit ignored in 32 KB mode)
         mapper1Data_.ramEnable = mapper1Data_.regData[3] & 0x10;
 
-        if (isDebugWrite()) {
-          std::cerr << "Cartridge::setROMByte " <<
-            std::hex << addr << " " << std::hex << int(c) << "\n";
-          std::cerr << "  regData[0] " << std::hex << int(mapper1Data_.regData[0]) << "\n";
-          std::cerr << "  regData[1] " << std::hex << int(mapper1Data_.regData[1]) << "\n";
-          std::cerr << "  regData[2] " << std::hex << int(mapper1Data_.regData[2]) << "\n";
-          std::cerr << "  regData[3] " << std::hex << int(mapper1Data_.regData[3]) << "\n";
-        }
+        // control register sets name table mirroring
+        if (regNum == 0)
+          updateMirroring();
+
+        // CHR mapping depends on bank and mirror values
+        if (mapper1Data_.mirror      != mirror    ||
+            mapper1Data_.vromBank[0] != vromBank0 ||
+            mapper1Data_.vromBank[1] != vromBank1)
+          chrChanged();
+
+        // register number and value
+        cpu->trace(Trace::Kind::MAPPER_WRITE, ushort(regNum), mapper1Data_.regValue,
+                   isDebugWrite());
 
         //---
 
@@ -459,6 +740,36 @@ numTiles() const
   return chrSize_/tileSize;
 }
 
+// decode 4K tile bank (16x16 grid of 8x8 chars) into 128x128 2 bit color indices
+void
+Cartridge::
+getTilePixels(int it, uchar *pixels, int stride) const
+{
+  int tileSize = 16*16*8*2;
+
+  int p = it*tileSize;
+
+  for (int ic = 0; ic < 256; ++ic) {
+    int x = (ic % 16)*8;
+    int y = (ic / 16)*8;
+
+    for (int iby = 0; iby < 8; ++iby, ++p) {
+      uchar c1 = chrRomData_[p    ];
+      uchar c2 = chrRomData_[p + 8];
+
+      uchar *line = pixels + (y + iby)*stride + x;
+
+      for (int ibx = 0; ibx < 8; ++ibx) {
+        int shift = 7 - ibx;
+
+        line[ibx] = ((c1 >> shift) & 1) | (((c2 >> shift) & 1) << 1);
+      }
+    }
+
+    p += 8;
+  }
+}
+
 void
 Cartridge::
 drawTile(int it)
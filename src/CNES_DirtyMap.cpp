@@ -0,0 +1,75 @@
+#include <CNES_DirtyMap.h>
+#include <cassert>
+
+namespace CNES {
+
+DirtyMap::
+DirtyMap(uint size) :
+ size_(size)
+{
+  assert(size_ > 0 && (size_ & (size_ - 1)) == 0);
+
+  bits_.resize((size_ + 63)/64);
+
+  clear();
+}
+
+void
+DirtyMap::
+set(uint addr, uint len)
+{
+  for (uint i = 0; i < len; ++i)
+    set(addr + i);
+}
+
+void
+DirtyMap::
+clear()
+{
+  for (auto &b : bits_)
+    b = 0;
+
+  dirty_ = false;
+}
+
+void
+DirtyMap::
+processRanges(const RangeProc &proc)
+{
+  if (! dirty_)
+    return;
+
+  int  nw    = int(bits_.size());
+  uint start = 0;
+  bool in    = false;
+
+  for (int iw = 0; iw < nw; ++iw) {
+    uint64_t w = bits_[iw];
+
+    // skip whole words with no change in state
+    if (! in && w == 0) continue;
+    if (in && w == ~uint64_t(0)) continue;
+
+    for (int ib = 0; ib < 64; ++ib) {
+      bool b = (w >> ib) & 1;
+
+      if (b == in) continue;
+
+      uint addr = iw*64 + ib;
+
+      if (b)
+        start = addr;
+      else
+        proc(ushort(start), ushort(addr - start));
+
+      in = b;
+    }
+  }
+
+  if (in)
+    proc(ushort(start), ushort(size_ - start));
+
+  clear();
+}
+
+}
@@ -0,0 +1,149 @@
+#include <CNES_Image.h>
+#include <CNES_Palette.h>
+#include <CNES_CRC.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace CNES {
+
+namespace {
+
+void
+putUInt(std::vector<uchar> &data, uint i)
+{
+  data.push_back(uchar(i >> 24));
+  data.push_back(uchar(i >> 16));
+  data.push_back(uchar(i >>  8));
+  data.push_back(uchar(i      ));
+}
+
+}
+
+Image::
+Image(int width, int height) :
+ width_(width), height_(height)
+{
+  data_.resize(size_t(width_)*height_*3);
+}
+
+void
+Image::
+setScreenPixels(const ushort *pixels)
+{
+  int np = width_*height_;
+
+  for (int i = 0; i < np; ++i)
+    Palette::rgb(pixels[i], data_[i*3 + 0], data_[i*3 + 1], data_[i*3 + 2]);
+}
+
+void
+Image::
+setRGBAPixels(const uchar *data, int stride)
+{
+  for (int y = 0; y < height_; ++y) {
+    const uchar *p = data + y*stride;
+
+    for (int x = 0; x < width_; ++x, p += 4)
+      setPixel(x, y, p[0], p[1], p[2]);
+  }
+}
+
+void
+Image::
+paletteRGB(uchar c, uchar &r, uchar &g, uchar &b)
+{
+  Palette::rgb(c & 0x3F, r, g, b);
+}
+
+bool
+Image::
+writePNG(const std::string &filename) const
+{
+  using Data = std::vector<uchar>;
+
+  auto writeChunk = [](FILE *fp, const char *type, const Data &data) {
+    Data chunk;
+
+    putUInt(chunk, uint(data.size()));
+
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+
+    putUInt(chunk, crc32(&chunk[4], chunk.size() - 4));
+
+    return fwrite(&chunk[0], 1, chunk.size(), fp) == chunk.size();
+  };
+
+  //---
+
+  // image data (filter type 0 per row)
+  Data raw;
+
+  size_t rowSize = size_t(width_)*3;
+
+  for (int y = 0; y < height_; ++y) {
+    raw.push_back(0);
+
+    raw.insert(raw.end(), data_.begin() + y*rowSize, data_.begin() + (y + 1)*rowSize);
+  }
+
+  // zlib stream of stored (uncompressed) deflate blocks
+  Data zdata = { 0x78, 0x01 };
+
+  size_t pos = 0;
+
+  do {
+    size_t len = std::min(raw.size() - pos, size_t(65535));
+
+    bool last = (pos + len == raw.size());
+
+    zdata.push_back(last ? 1 : 0);
+    zdata.push_back(uchar(len & 0xFF));
+    zdata.push_back(uchar(len >> 8));
+    zdata.push_back(uchar(~len & 0xFF));
+    zdata.push_back(uchar((~len >> 8) & 0xFF));
+
+    zdata.insert(zdata.end(), raw.begin() + pos, raw.begin() + pos + len);
+
+    pos += len;
+  } while (pos < raw.size());
+
+  uint a = 1, b = 0;
+
+  for (auto c : raw) {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+
+  putUInt(zdata, (b << 16) | a);
+
+  //---
+
+  Data header;
+
+  putUInt(header, width_);
+  putUInt(header, height_);
+
+  header.push_back(8); // bit depth
+  header.push_back(2); // color type (RGB)
+  header.push_back(0); // compression
+  header.push_back(0); // filter
+  header.push_back(0); // interlace
+
+  FILE *fp = fopen(filename.c_str(), "wb");
+  if (! fp) return false;
+
+  static const uchar signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  bool rc = (fwrite(signature, 1, 8, fp) == 8);
+
+  rc = rc && writeChunk(fp, "IHDR", header);
+  rc = rc && writeChunk(fp, "IDAT", zdata);
+  rc = rc && writeChunk(fp, "IEND", Data());
+
+  fclose(fp);
+
+  return rc;
+}
+
+}
@@ -0,0 +1,60 @@
+#include <CNES_Input.h>
+
+namespace CNES {
+
+Input::
+Input()
+{
+  for (int i = 0; i < s_numControllers; ++i) {
+    buttons_[i].store(0);
+
+    shift_[i] = 0;
+  }
+}
+
+void
+Input::
+setStrobe(uchar c)
+{
+  bool strobe = (c & 0x01);
+
+  // sample buttons once on strobe release
+  if (strobe_ && ! strobe) {
+    for (int i = 0; i < s_numControllers; ++i)
+      shift_[i] = buttons(i);
+  }
+
+  strobe_ = strobe;
+}
+
+uchar
+Input::
+read(int i)
+{
+  i &= 1;
+
+  // while strobe is high shift register is continuously reloaded (reports A)
+  if (strobe_)
+    return (buttons(i) & 0x01);
+
+  uchar b = (shift_[i] & 0x01);
+
+  // official controllers report 1 after the 8 buttons
+  shift_[i] = (shift_[i] >> 1) | 0x80;
+
+  return b;
+}
+
+uchar
+Input::
+peek(int i) const
+{
+  i &= 1;
+
+  if (strobe_)
+    return (buttons(i) & 0x01);
+
+  return (shift_[i] & 0x01);
+}
+
+}
@@ -1,9 +1,15 @@
 #include <CNES_Machine.h>
 #include <CNES_CPU.h>
 #include <CNES_PPU.h>
+#include <CNES_APU.h>
 #include <CNES_Cartridge.h>
+#include <CNES_AudioSink.h>
 
 #include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
 
 namespace CNES {
 
@@ -25,12 +31,197 @@ init()
   if (! cart_)
     cart_ = new Cartridge(this);
 
+  if (! apu_)
+    apu_ = new APU(this);
+
   initMemory();
 
   // call 6502 reset vector
   cpu_->resetSystem();
 }
 
+bool
+Machine::
+runFrame()
+{
+  auto frameNum = ppu_->frameNum();
+
+  while (ppu_->frameNum() == frameNum) {
+    if (cpu_->isHalt())
+      return false;
+
+    // instruction start state for profiler call stack tracking
+    bool   traceCalls = profiler_.isCallStacks();
+    ushort pc         = 0;
+    uchar  opcode     = 0;
+    bool   inNMI      = false;
+
+    if (traceCalls) {
+      pc     = cpu_->PC();
+      opcode = cpu_->opcodeByte(pc);
+      inNMI  = cpu_->inNMI();
+    }
+
+    {
+      CNES_STATS_TIMER(stats_, CPU_STEP);
+
+      cpu_->pollIRQ();
+
+      cpu_->step();
+    }
+
+    if (traceCalls)
+      profiler_.traceInstruction(pc, opcode, ! inNMI && cpu_->inNMI());
+
+    CNES_STATS_COUNT(stats_, INSTRUCTIONS);
+
+    ppu_->drawPendingLines();
+  }
+
+  pacer_.endFrame();
+
+  // sink fill level at frame start (after any pacing wait) for rate control
+  audioFill_ = (audioSink_ ? audioSink_->fillLevel() : -1.0);
+
+  return true;
+}
+
+bool
+Machine::
+loadRenderOverrides(const std::string &filename)
+{
+  std::ifstream is(filename);
+  if (! is) return false;
+
+  std::string line;
+
+  while (std::getline(is, line)) {
+    std::istringstream iss(line);
+
+    std::string crcStr, modeStr;
+
+    if (! (iss >> crcStr >> modeStr) || crcStr[0] == '#')
+      continue;
+
+    PPU::RenderMode mode;
+
+    if (! PPU::nameToRenderMode(modeStr, mode)) {
+      std::cerr << "Invalid render mode '" << modeStr << "' in '" << filename << "'\n";
+      continue;
+    }
+
+    setRenderOverride(uint(std::strtoul(crcStr.c_str(), nullptr, 16)), mode);
+  }
+
+  return true;
+}
+
+void
+Machine::
+cartridgeLoaded()
+{
+  auto mode = defaultRenderMode_;
+
+  auto p = renderOverrides_.find(cart_->crc());
+
+  if (p != renderOverrides_.end())
+    mode = (*p).second;
+
+  ppu_->setRenderMode(mode, /*immediate*/true);
+}
+
+void
+Machine::
+flushChanges()
+{
+  cpu_->flushChanges();
+  ppu_->flushChanges();
+}
+
+bool
+Machine::
+startSoundLog(const std::string &filename)
+{
+  return soundLog_.open(filename, cpu_->cycles(), PPU::cpuSpeed());
+}
+
+void
+Machine::
+stopSoundLog()
+{
+  soundLog_.close(cpu_->cycles());
+}
+
+void
+Machine::
+setAudioSink(AudioSink *sink)
+{
+  audioSink_ = sink;
+
+  if (audioSink_) {
+    apu_->setSampleRate(audioSink_->sampleRate());
+
+    pacer_.setAudioQueued([this]() { return audioSink_->latency(); });
+
+    // AUDIO pacer waits until sink drains to the rate control fill target so both
+    // aim for the same level
+    if (audioSink_->maxLatency() > 0.0)
+      pacer_.setAudioLatency(audioFillTarget_*audioSink_->maxLatency());
+  }
+  else
+    pacer_.setAudioQueued(Pacer::AudioQueued());
+
+  audioFill_ = -1.0;
+}
+
+void
+Machine::
+frameDone()
+{
+  updateAudio();
+
+  stats_.endFrame();
+}
+
+// send frame's samples to sink and adjust resampling ratio from sink fill level
+void
+Machine::
+updateAudio()
+{
+  if (! audioSink_)
+    return;
+
+  apu_->endFrame();
+
+  int n = apu_->samplesAvail();
+
+  if (n > 0) {
+    audioSamples_.resize(n);
+
+    n = apu_->readSamples(&audioSamples_[0], n);
+
+    audioSink_->writeSamples(&audioSamples_[0], n);
+  }
+
+  //---
+
+  // dynamic rate control from fill level at frame start: fuller than target -> raise
+  // clock rate (fewer samples), emptier -> lower clock rate (more samples). Target
+  // leaves room for a frame of samples in the sink. With AUDIO pacing the frame rate
+  // already follows the audio clock (wait drains sink to the same target) so the
+  // rate stays nominal.
+  if (audioFill_ >= 0.0) {
+    double d = 0.0;
+
+    if (pacer_.mode() != Pacer::Mode::AUDIO)
+      d = std::min(std::max((audioFill_ - audioFillTarget_)/audioFillTarget_, -1.0), 1.0);
+
+    double delta = audioRateDelta_*d;
+
+    apu_->setClockRate(PPU::cpuSpeed()*(1.0 + delta));
+  }
+}
+
 void
 Machine::
 initMemory()
@@ -0,0 +1,373 @@
+#include <CNES_NTSC.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace CNES {
+
+namespace {
+
+// composite signal levels (low and high for luma level 0-3, black and white)
+const float s_lowLevels [4] = { 0.350f, 0.518f, 0.962f, 1.550f };
+const float s_highLevels[4] = { 1.094f, 1.506f, 1.962f, 1.962f };
+
+const float s_blackLevel  = 0.518f;
+const float s_whiteLevel  = 1.962f;
+const float s_attenuation = 0.746f; // emphasis
+
+const int s_yWidth = 12; // luma box filter samples (one color cycle)
+const int s_cWidth = 24; // chroma box filter samples (two color cycles)
+
+// color cycle phase (0-11) in which color (hue 0-11) is high
+inline bool
+inColorPhase(int color, int phase)
+{
+  return (color + phase) % 12 < 6;
+}
+
+// normalized composite signal of pixel (emphasis*64 + palette index) at sample phase
+float
+pixelSignal(int pixel, int phase)
+{
+  int color = (pixel & 0x0F);
+  int level = (pixel >> 4) & 0x03;
+  int ec    = (pixel >> 6) & 0x07;
+
+  // colors $xE and $xF are black
+  if (color > 13)
+    level = 1;
+
+  float low  = s_lowLevels [level];
+  float high = s_highLevels[level];
+
+  if (color == 0 ) low  = high;
+  if (color > 12 ) high = low;
+
+  float signal = (inColorPhase(color, phase) ? high : low);
+
+  // emphasis attenuates signal in phase of red (0), green (4) and blue (8)
+  if (((ec & 0x01) && inColorPhase(0, phase)) ||
+      ((ec & 0x02) && inColorPhase(4, phase)) ||
+      ((ec & 0x04) && inColorPhase(8, phase)))
+    signal *= s_attenuation;
+
+  return (signal - s_blackLevel)/(s_whiteLevel - s_blackLevel);
+}
+
+// clamp in integer (same result as clamping to 0-1 first) so loops vectorize
+inline uchar
+clampColor(float c)
+{
+  return uchar(std::min(std::max(int(c*255.0f + 0.5f), 0), 255));
+}
+
+}
+
+//---
+
+NTSCFilter::
+NTSCFilter(int numThreads)
+{
+  initTables();
+
+  if (numThreads <= 0)
+    numThreads = std::min(std::max(int(std::thread::hardware_concurrency()), 1), 4);
+
+  startThreads(numThreads - 1);
+}
+
+NTSCFilter::
+~NTSCFilter()
+{
+  stopThreads();
+}
+
+void
+NTSCFilter::
+setNumThreads(int n)
+{
+  stopThreads();
+
+  startThreads(std::max(n, 1) - 1);
+}
+
+// partial sums of signal of each pixel and start phase modulated by decode subcarrier
+// (hue offset, saturation and brightness applied here so decode is sums only)
+void
+NTSCFilter::
+initTables()
+{
+  int n = 512*3*s_sumsPerPixel;
+
+  signalY_.resize(n);
+  signalI_.resize(n);
+  signalQ_.resize(n);
+
+  // chroma amplitude of square wave demodulated by box filter is 1/2 of sine
+  float gain = 2.0f*saturation_*brightness_;
+
+  for (int pixel = 0; pixel < 512; ++pixel) {
+    for (int ip = 0; ip < 3; ++ip) {
+      int i = (pixel*3 + ip)*s_sumsPerPixel;
+
+      float sy = 0.0f, si = 0.0f, sq = 0.0f;
+
+      for (int k = 0; k < s_samplesPerPixel; ++k) {
+        signalY_[i + k] = sy;
+        signalI_[i + k] = si;
+        signalQ_[i + k] = sq;
+
+        int phase = (ip*4 + k) % s_colorCycle;
+
+        float s = pixelSignal(pixel, phase);
+        float a = float(M_PI)*(phase + hue_)/6.0f;
+
+        sy += brightness_*s;
+        si += gain*s*std::cos(a);
+        sq += gain*s*std::sin(a);
+      }
+
+      signalY_[i + s_samplesPerPixel] = sy;
+      signalI_[i + s_samplesPerPixel] = si;
+      signalQ_[i + s_samplesPerPixel] = sq;
+    }
+  }
+}
+
+void
+NTSCFilter::
+startThreads(int n)
+{
+  stopping_   = false;
+  numThreads_ = n + 1;
+
+  for (int i = 0; i < n; ++i)
+    workers_.emplace_back(&NTSCFilter::workerThread, this, i + 1, jobNum_);
+}
+
+void
+NTSCFilter::
+stopThreads()
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  stopping_ = true;
+  }
+
+  startCond_.notify_all();
+
+  for (auto &worker : workers_)
+    worker.join();
+
+  workers_.clear();
+
+  numThreads_ = 1;
+}
+
+// worker filters its block of lines of each job
+void
+NTSCFilter::
+workerThread(int ithread, ulong jobNum)
+{
+  while (true) {
+    Job job;
+    int nt;
+
+    {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    startCond_.wait(lock, [&]() { return stopping_ || jobNum_ != jobNum; });
+
+    if (stopping_)
+      return;
+
+    jobNum = jobNum_;
+    job    = job_;
+    nt     = numThreads_;
+    }
+
+    filterLines(job, job.h*ithread/nt, job.h*(ithread + 1)/nt);
+
+    {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    ++numDone_;
+    }
+
+    doneCond_.notify_one();
+  }
+}
+
+bool
+NTSCFilter::
+filter(const ushort *pixels, int w, int h, int pixelStride, ulong frameNum,
+       Palette::Format format, uchar *dest, int destStride)
+{
+  if (format == Palette::Format::INDEXED8)
+    return false;
+
+  Job job;
+
+  job.pixels      = pixels;
+  job.w           = w;
+  job.h           = h;
+  job.pixelStride = pixelStride;
+  job.phase       = int(frameNum & 1)*4; // burst phase alternates each frame
+  job.format      = format;
+  job.dest        = dest;
+  job.destStride  = destStride;
+
+  int nt = numThreads();
+
+  if (nt == 1) {
+    filterLines(job, 0, h);
+    return true;
+  }
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  job_     = job;
+  numDone_ = 0;
+
+  ++jobNum_;
+  }
+
+  startCond_.notify_all();
+
+  filterLines(job, 0, h/nt);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  doneCond_.wait(lock, [&]() { return numDone_ == nt - 1; });
+
+  return true;
+}
+
+// encode lines y1 to y2 (exclusive) as composite samples and decode at output
+// pixel centers from prefix sums of modulated samples. Stages are separate loops
+// over separate Y, I, Q (and R, G, B) arrays with the output format switch outside
+// the pixel loops so they vectorize
+void
+NTSCFilter::
+filterLines(const Job &job, int y1, int y2) const
+{
+  int ns   = job.w*s_samplesPerPixel;
+  int pad  = s_cWidth/2;
+  int np   = ns + 2*pad;
+  int outW = outputWidth(job.w);
+
+  // prefix sums of composite samples (padding is black)
+  Samples sumY(np + 1), sumI(np + 1), sumQ(np + 1);
+
+  // decoded YIQ and RGB of output pixels
+  Samples Y(outW), I(outW), Q(outW);
+
+  std::vector<uchar> R(outW), G(outW), B(outW);
+
+  // sample of each output pixel center (in padded samples)
+  std::vector<int> centers(outW);
+
+  for (int x = 0; x < outW; ++x)
+    centers[x] = pad + int((x + 0.5f)*ns/outW);
+
+  float *py = &sumY[0], *pi = &sumI[0], *pq = &sumQ[0];
+
+  for (int y = y1; y < y2; ++y) {
+    const ushort *pixels = job.pixels + y*job.pixelStride;
+
+    // line phase advances by 4 samples (1/3 color cycle) per line
+    int phase = (job.phase + 4*y) % s_colorCycle;
+
+    // prefix sums from pixel partial sums (only the pixel totals are a serial chain)
+    float ty = 0.0f, ti = 0.0f, tq = 0.0f;
+
+    for (int x = 0; x < job.w; ++x) {
+      ushort pixel = pixels[x];
+
+      int ind = ((pixel >> 2) & 0x1C0) | (pixel & 0x3F);
+      int ip  = ((phase + x*s_samplesPerPixel) % s_colorCycle)/4;
+
+      const float *cy = &signalY_[(ind*3 + ip)*s_sumsPerPixel];
+      const float *ci = &signalI_[(ind*3 + ip)*s_sumsPerPixel];
+      const float *cq = &signalQ_[(ind*3 + ip)*s_sumsPerPixel];
+
+      int is = pad + x*s_samplesPerPixel;
+
+      for (int k = 0; k < s_samplesPerPixel; ++k) {
+        py[is + k] = ty + cy[k];
+        pi[is + k] = ti + ci[k];
+        pq[is + k] = tq + cq[k];
+      }
+
+      ty += cy[s_samplesPerPixel];
+      ti += ci[s_samplesPerPixel];
+      tq += cq[s_samplesPerPixel];
+    }
+
+    for (int i = pad + ns; i <= np; ++i) {
+      py[i] = ty;
+      pi[i] = ti;
+      pq[i] = tq;
+    }
+
+    // box filters over whole color cycles
+    for (int x = 0; x < outW; ++x) {
+      int c = centers[x];
+
+      Y[x] = (py[c + s_yWidth/2] - py[c - s_yWidth/2])/s_yWidth;
+      I[x] = (pi[c + s_cWidth/2] - pi[c - s_cWidth/2])/s_cWidth;
+      Q[x] = (pq[c + s_cWidth/2] - pq[c - s_cWidth/2])/s_cWidth;
+    }
+
+    const float *Y1 = &Y[0], *I1 = &I[0], *Q1 = &Q[0];
+
+    uchar *R1 = &R[0], *G1 = &G[0], *B1 = &B[0];
+
+    for (int x = 0; x < outW; ++x) {
+      float y1 = Y1[x], i1 = I1[x], q1 = Q1[x];
+
+      R1[x] = clampColor(y1 + 0.946882f*i1 + 0.623557f*q1);
+      G1[x] = clampColor(y1 - 0.274788f*i1 - 0.635691f*q1);
+      B1[x] = clampColor(y1 - 1.108545f*i1 + 1.709007f*q1);
+    }
+
+    //---
+
+    uchar *dest = job.dest + y*job.destStride;
+
+    switch (job.format) {
+      case Palette::Format::BGRA8888: {
+        for (int x = 0; x < outW; ++x) {
+          uchar *d = dest + 4*x;
+
+          d[0] = B1[x]; d[1] = G1[x]; d[2] = R1[x]; d[3] = 0xFF;
+        }
+
+        break;
+      }
+      case Palette::Format::RGB565: {
+        // dest may not be 2 byte aligned
+        for (int x = 0; x < outW; ++x) {
+          ushort c = ushort(((R1[x] >> 3) << 11) | ((G1[x] >> 2) << 5) | (B1[x] >> 3));
+
+          memcpy(dest + 2*x, &c, 2);
+        }
+
+        break;
+      }
+      default: {
+        for (int x = 0; x < outW; ++x) {
+          uchar *d = dest + 4*x;
+
+          d[0] = R1[x]; d[1] = G1[x]; d[2] = B1[x]; d[3] = 0xFF;
+        }
+
+        break;
+      }
+    }
+  }
+}
+
+}
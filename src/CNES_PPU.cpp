@@ -2,10 +2,30 @@
 #include <CNES_Machine.h>
 #include <CNES_CPU.h>
 #include <CNES_Cartridge.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 
 namespace CNES {
 
+namespace {
+
+// reverse bits of pattern byte (horizontal flip)
+inline uchar
+reverseBits(uchar b)
+{
+  b = uchar(((b & 0xF0) >> 4) | ((b & 0x0F) << 4));
+  b = uchar(((b & 0xCC) >> 2) | ((b & 0x33) << 2));
+  b = uchar(((b & 0xAA) >> 1) | ((b & 0x55) << 1));
+
+  return b;
+}
+
+}
+
+//---
+
 PPU::
 PPU(Machine *machine) :
  machine_(machine)
@@ -22,10 +42,24 @@ PPU(Machine *machine) :
 
   memset(&screenPixels_[0], 0, np*sizeof(ushort));
 
+  // whole screen damaged until first presented
+  for (int y = 0; y < s_visibleLines; ++y) {
+    lineDamageX1_[y] = 0;
+    lineDamageX2_[y] = s_visiblePixels;
+  }
+
+  damage_.add(0, 0, s_visiblePixels, s_visibleLines);
+
   // init line pixels
   linePixels_.resize(s_visiblePixels);
 
   memset(&linePixels_[0], 0, s_visiblePixels*sizeof(uchar));
+
+  // init char line span cache
+  spanCache_.resize(s_spanCacheSize);
+
+  // init name table slots
+  setMirroring(Mirroring::HORIZONTAL);
 }
 
 PPU::
@@ -39,77 +73,39 @@ PPU::
 getByte(ushort addr) const
 {
   auto returnChar = [&](uchar c) {
-    if (isDebugRead() && ! in_ppu_)
-      std::cerr << "PPU::getByte " <<
-        std::hex << addr << " " << std::hex << int(c) << "\n";
+    if (! in_ppu_) {
+      auto *cpu = machine_->getCPU();
+
+      if (! cpu->isDebugger())
+        cpu->trace(Trace::Kind::PPU_READ, addr, c, isDebugRead());
+    }
+
     return c;
   };
 
-  // With vertical mirroring, tables 2 and 3 are the mirrors of pages 0 and 1 appropriately.
-  // With horizontal mirroring, pages 1 and 3 are the mirrors of pages 0 and 2 appropriately.
+  addr &= 0x3FFF;
 
-  // Pattern Table 0 (256x2x8, may be VROM)
-  if      (addr < 0x1000) {
+  // Pattern Tables 0 and 1 (256x2x8, may be VROM)
+  if      (addr < 0x2000) {
     uchar c = getVRAMByte(addr);
 
     return returnChar(c);
   }
-  // Pattern Table 1 (256x2x8, may be VROM)
-  else if (addr < 0x2000) {
-    uchar c = getVRAMByte(addr);
+  // Name/Attribute Tables 0-3 (mirrored by slot, $3000-$3EFF mirrors $2000-$2EFF)
+  else if (addr < 0x3F00) {
+    uchar c = nameTablePage_[(addr >> 10) & 0x03][addr & 0x03FF];
 
     return returnChar(c);
   }
-  // Name Table 0 (32x25 tiles)
-  else if (addr < 0x23C0) {
-  }
-  // Attribute Table 0
-  else if (addr < 0x2400) {
-  }
-  // Name Table 1 (32x25 tiles)
-  else if (addr < 0x27C0) {
-  }
-  // Attribute Table 1
-  else if (addr < 0x2800) {
-  }
-  // Name Table 2 (32x25 tiles)
-  else if (addr < 0x2BC0) {
-    auto *cpu = machine_->getCPU();
 
-    if (! cpu->isDebugger())
-      std::cerr << "PPU::getByte (Name Table 2) " << std::hex << addr << "\n";
-  }
-  // Attribute Table 2
-  else if (addr < 0x2C00) {
-  }
-  // Name Table 3 (32x25 tiles)
-  else if (addr < 0x2FC0) {
-    auto *cpu = machine_->getCPU();
+  // Image and Sprite Palette
+  //
+  // The $3F00 and $3F10 locations in VRAM mirror each other (i.e. it
+  // is the same memory cell) and define the background color of the picture.
+  if (addr == 0x3F10)
+    addr = 0x3F00;
 
-    if (! cpu->isDebugger())
-      std::cerr << "PPU::getByte (Name Table 3) " << std::hex << addr << "\n";
-  }
-  // Attribute Table 3
-  else if (addr < 0x3000) {
-  }
-  // Empty
-  else if (addr < 0x3F00) {
-  }
-  // Image Palette
-  else if (addr < 0x3F10) {
-  }
-  // Sprite Palette
-  else if (addr < 0x3F20) {
-    // The $3F00 and $3F10 locations in VRAM mirror each other (i.e. it
-    // is the same memory cell) and define the background color of the picture.
-    if (addr == 0x3F10)
-      addr = 0x3F00;
-  }
-  // Empty
-  else if (addr < 0x4000) {
-  }
-
-  uchar c = mem_[addr & 0x3FFF];
+  uchar c = mem_[addr];
 
   return returnChar(c);
 }
@@ -149,6 +145,9 @@ getControlByte(ushort addr) const
   // PPU Status Register (PPUSTATUS)
   // (read only)
   else if (addr == 0x2002) {
+    // sprite 0 hit resolved on read (up to current cpu time)
+    const_cast<PPU *>(this)->resolveSpriteHit();
+
     // Init width least significant bits previously written into a PPU register
     c = ppuVal_ & 0x1F;
 
@@ -165,7 +164,7 @@ getControlByte(ushort addr) const
     //th->setSpriteHit(false);
       th->setVBlank   (false);
 
-      byteId_ = 0;
+      w_ = false;
     }
   }
   // Sprite Memory Address (OAMADDR)
@@ -178,9 +177,8 @@ getControlByte(ushort addr) const
     if (! cpu->isDebugger()) {
       c = spriteMem_[spriteAddr_++];
 
-      if (isDebugRead() && ! in_ppu_)
-        std::cerr << "CPU::getSpriteByte " <<
-          std::hex << addr << " " << std::hex << int(c) << "\n";
+      if (! in_ppu_)
+        cpu->trace(Trace::Kind::SPRITE_READ, spriteAddr_ - 1, c, isDebugRead());
     }
     else {
       c = spriteMem_[spriteAddr_];
@@ -199,18 +197,20 @@ getControlByte(ushort addr) const
   // PPU Memory Data (PPUDATA)
   else if (addr == 0x2007) {
     if (! cpu->isDebugger()) {
-      if (ppuAddr_ < 0x3F00) {
+      ushort addr1 = v_ & 0x3FFF;
+
+      if (addr1 < 0x3F00) {
         c = ppuBuffer_;
 
-        ppuBuffer_ = getByte(ppuAddr_);
+        ppuBuffer_ = getByte(addr1);
       }
       else {
-        c = getByte(ppuAddr_);
+        c = getByte(addr1);
 
-        ppuBuffer_ = getByte(ppuAddr_); // TODO: mirrored nametable data ?
+        ppuBuffer_ = getByte(addr1 - 0x1000); // name table data under palette
       }
 
-      ++ppuAddr_;
+      v_ = (v_ + (verticalWrite_ ? s_hChars : 1)) & 0x7FFF;
     }
     else
       c = ppuBuffer_;
@@ -231,8 +231,10 @@ setControlByte(ushort addr, uchar c)
   if      (addr == 0x2000) {
     // c & 0x01 : Add 256 to the X scroll position
     // c & 0x02 : Add 240 to the Y scroll position
-    nameTable_     = (c & 0x03);                // TODO: mirroring ?
-    nameTableAddr_ = 0x2000 + nameTable_*0x400; // TODO: mirroring ?
+    nameTable_     = (c & 0x03);
+    nameTableAddr_ = 0x2000 + nameTable_*0x400;
+
+    t_ = (t_ & 0x73FF) | ((c & 0x03) << 10);
 
     verticalWrite_      = (c & 0x04) >> 2;
     spritePatternAddr_  = (c & 0x08 ? 0x1000 : 0x0000);
@@ -265,38 +267,41 @@ setControlByte(ushort addr, uchar c)
   }
   // Sprite Memory Data (OAMDATA)
   else if (addr == 0x2004) {
-    spriteMem_[spriteAddr_++] = c;
+    spritesDirty_.set(spriteAddr_);
 
-    spritesChanged();
+    spriteMem_[spriteAddr_++] = c;
   }
   // Background Scroll (PPUSCROLL)
-  // TODO: shares internal register with PPUADDR ?
+  // (coarse/fine x then coarse/fine y in t, shares write toggle with PPUADDR)
   else if (addr == 0x2005) {
-    // ignore vertical scroll value if >= 240
-    if (byteId_ != 1 || c < 0xF0)
-      scrollHV_[byteId_] = c;
+    if (! w_) {
+      t_     = (t_ & 0x7FE0) | (c >> 3);
+      fineX_ = c & 0x07;
+    }
+    else
+      t_ = (t_ & 0x0C1F) | ((c & 0x07) << 12) | ((c & 0xF8) << 2);
 
-    byteId_ = 1 - byteId_;
+    w_ = ! w_;
   }
   // PPU Memory Address (PPUADDR)
+  // (high then low byte of t, v set from t on second write)
   else if (addr == 0x2006) {
     ppuVal_ = c;
 
-    ppuAddrHL_[byteId_] = ppuVal_;
-
-    byteId_ = 1 - byteId_;
+    if (! w_)
+      t_ = (t_ & 0x00FF) | ((c & 0x3F) << 8);
+    else {
+      t_ = (t_ & 0x7F00) | c;
+      v_ = t_;
+    }
 
-    ppuAddr_ = (ppuAddrHL_[0] << 8) | ppuAddrHL_[1];
-    ppuAddr_ &= 0x3FFF;
+    w_ = ! w_;
   }
   // PPU Memory Data (PPUDATA)
   else if (addr == 0x2007) {
-    setByte(ppuAddr_, c);
+    setByte(v_ & 0x3FFF, c);
 
-    if (verticalWrite_)
-      ppuAddr_ += s_hChars;
-    else
-      ++ppuAddr_;
+    v_ = (v_ + (verticalWrite_ ? s_hChars : 1)) & 0x7FFF;
   }
   else {
     std::cerr << "Write PPU Unhandled\n";
@@ -309,17 +314,35 @@ setByte(ushort addr, uchar c)
 {
   auto *cpu = machine_->getCPU();
 
-  if (isDebugWrite() && ! cpu->isDebugger())
-    std::cerr << "PPU::setByte " <<
-          std::hex << addr << " " << std::hex << int(c) << "\n";
+  if (! cpu->isDebugger())
+    cpu->trace(Trace::Kind::PPU_WRITE, addr, c, isDebugWrite());
+
+  addr &= 0x3FFF;
 
   // Pattern Table 0 (256x2x8, may be VROM)
   if      (addr < 0x1000) {
-    mem_[addr & 0x3FFF] = c;
+    mem_[addr] = c;
+
+    ++spanGeneration_;
   }
   // Pattern Table 1 (256x2x8, may be VROM)
   else if (addr < 0x2000) {
-    mem_[addr & 0x3FFF] = c;
+    mem_[addr] = c;
+
+    ++spanGeneration_;
+  }
+  // Name/Attribute Tables 0-3 (write all slots sharing page)
+  else if (addr < 0x3F00) {
+    uchar *page = nameTablePage_[(addr >> 10) & 0x03];
+
+    page[addr & 0x03FF] = c;
+
+    for (int i = 0; i < 4; ++i) {
+      if (nameTablePage_[i] == page)
+        memDirty_.set(0x2000 + i*0x0400 + (addr & 0x03FF));
+    }
+
+    return;
   }
   else {
     // The $3F00 and $3F10 locations in VRAM mirror each other (i.e. it
@@ -327,10 +350,51 @@ setByte(ushort addr, uchar c)
     if (addr == 0x3F10)
       addr = 0x3F00;
 
-    mem_[addr & 0x3FFF] = c;
+    mem_[addr] = c;
+
+    ++spanGeneration_;
+  }
+
+  memDirty_.set(addr);
+}
+
+void
+PPU::
+setMirroring(Mirroring mirroring)
+{
+  // VRAM pages (only A and B on console, C and D for four screen cartridges)
+  uchar *pageA = &mem_[0x2000];
+  uchar *pageB = &mem_[0x2400];
+  uchar *pageC = &mem_[0x2800];
+  uchar *pageD = &mem_[0x2C00];
+
+  mirroring_ = mirroring;
+
+  switch (mirroring_) {
+    case Mirroring::HORIZONTAL:
+      nameTablePage_[0] = pageA; nameTablePage_[1] = pageA;
+      nameTablePage_[2] = pageB; nameTablePage_[3] = pageB;
+      break;
+    case Mirroring::VERTICAL:
+      nameTablePage_[0] = pageA; nameTablePage_[1] = pageB;
+      nameTablePage_[2] = pageA; nameTablePage_[3] = pageB;
+      break;
+    case Mirroring::SINGLE_A:
+      nameTablePage_[0] = pageA; nameTablePage_[1] = pageA;
+      nameTablePage_[2] = pageA; nameTablePage_[3] = pageA;
+      break;
+    case Mirroring::SINGLE_B:
+      nameTablePage_[0] = pageB; nameTablePage_[1] = pageB;
+      nameTablePage_[2] = pageB; nameTablePage_[3] = pageB;
+      break;
+    case Mirroring::FOUR_SCREEN:
+      nameTablePage_[0] = pageA; nameTablePage_[1] = pageB;
+      nameTablePage_[2] = pageC; nameTablePage_[3] = pageD;
+      break;
   }
 
-  memChanged(addr, 1);
+  // visible name table contents change
+  memDirty_.set(0x2000, 0x1000);
 }
 
 void
@@ -341,7 +405,21 @@ copySpriteMem(uchar c)
 
   cpu->memget(c << 8, &spriteMem_[0], 0x100);
 
-  spritesChanged();
+  spritesDirty_.set(0, 0x100);
+}
+
+// send coalesced change notifications
+void
+PPU::
+flushChanges()
+{
+  memDirty_.processRanges([&](ushort addr, ushort len) { memChanged(addr, len); });
+
+  if (spritesDirty_.isDirty()) {
+    spritesDirty_.clear();
+
+    spritesChanged();
+  }
 }
 
 void
@@ -350,16 +428,418 @@ tick(uchar n)
 {
   // display runs at 60hz (NTSC), 50hz (PAL)
   // cpu @ 1.79Mhz (NTSC), 1.66Mhz (PAL)
+  // ppu runs 3 dots per cpu cycle (NTSC) and 341 dots per line, so count
+  // dots to avoid drift from integer ticks per line
+  if (renderMode_ == RenderMode::DOT && videoEnabled_) {
+    tickDots(n*s_dotsPerTick);
+    return;
+  }
+
+  int dot1 = lineDots_;
+
+  lineDots_ += n*s_dotsPerTick;
+
+  updateScroll(dot1, std::min(lineDots_, s_numPixels));
+
+  while (lineDots_ >= s_numPixels) {
+    lineDots_ -= s_numPixels;
+
+    nextLine();
+
+    updateScroll(0, std::min(lineDots_, s_numPixels));
+  }
+}
+
+// start next (cpu time) line
+void
+PPU::
+nextLine()
+{
+  ++numDrawLines_;
+
+  if (++tickLine_ >= s_numLines) {
+    tickLine_ = 0;
+
+    ++frameNum_;
+
+    // switch render backend between frames
+    renderMode_ = pendingRenderMode_;
+
+    machine_->frameDone();
+  }
+
+  // new frame for sprite 0 hit search
+  if (tickLine_ == s_topMargin) {
+    hitLine_     = -1;
+    hitNextLine_ = 0;
+  }
+
+  // save scroll state for drawing visible line
+  int pixelLine = tickLine_ - s_topMargin;
+
+  if (pixelLine >= 0 && pixelLine < s_visibleLines) {
+    lineV_    [pixelLine] = v_;
+    lineFineX_[pixelLine] = fineX_;
+  }
+}
+
+void
+PPU::
+setRenderMode(RenderMode mode, bool immediate)
+{
+  pendingRenderMode_ = mode;
+
+  if (immediate)
+    renderMode_ = mode;
+}
+
+const char *
+PPU::
+renderModeName(RenderMode mode)
+{
+  switch (mode) {
+    case RenderMode::SCANLINE: return "scanline";
+    case RenderMode::DOT     : return "dot";
+    default                  : return "";
+  }
+}
+
+bool
+PPU::
+nameToRenderMode(const std::string &name, RenderMode &mode)
+{
+  if      (name == "scanline") mode = RenderMode::SCANLINE;
+  else if (name == "dot"     ) mode = RenderMode::DOT;
+  else                         return false;
+
+  return true;
+}
+
+// apply v register scroll updates for dots [dot1, dot2) of current (cpu time) line
+void
+PPU::
+updateScroll(int dot1, int dot2)
+{
+  // only changed at end of visible and pre-render lines
+  if (dot2 <= 256)
+    return;
+
+  if (! isRendering())
+    return;
+
+  bool preRender = (tickLine_ == s_topMargin - 1);
+
+  if (! preRender && (tickLine_ < s_topMargin || tickLine_ >= s_topMargin + s_visibleLines))
+    return;
+
+  // dot 256: increment y, dot 257: copy horizontal bits from t
+  if (dot1 <= 256) {
+    incrementScrollY();
+
+    v_ = (v_ & 0x7BE0) | (t_ & 0x041F);
+  }
+
+  // pre-render dots 280-304: copy vertical bits from t
+  if (preRender && dot1 < 305 && dot2 > 280)
+    v_ = (v_ & 0x041F) | (t_ & 0x7BE0);
+}
+
+// increment coarse x, wrap into horizontal name table
+void
+PPU::
+incrementScrollX()
+{
+  if ((v_ & 0x001F) == 31) {
+    v_ &= 0x7FE0;
+    v_ ^= 0x0400;
+  }
+  else
+    ++v_;
+}
+
+// increment fine y, wrap coarse y at end of name table (29) or attribute rows (31)
+void
+PPU::
+incrementScrollY()
+{
+  v_ = incrementedScrollY(v_);
+}
+
+ushort
+PPU::
+incrementedScrollY(ushort v)
+{
+  if ((v & 0x7000) != 0x7000)
+    return ushort(v + 0x1000);
+
+  v &= 0x0FFF;
+
+  int coarseY = (v & 0x03E0) >> 5;
 
-  static const int ticksPerLine = 1'790'000/60/s_numLines;
+  if      (coarseY == 29) {
+    coarseY = 0;
 
-  lineTicks_ -= n;
+    v ^= 0x0800; // switch vertical name table
+  }
+  else if (coarseY == 31)
+    coarseY = 0;
+  else
+    ++coarseY;
+
+  return ushort((v & 0x7C1F) | (coarseY << 5));
+}
+
+//---
+
+// step dot renderer n dots (pixels output as cpu time passes so mid line
+// register writes take effect at the right dot)
+void
+PPU::
+tickDots(int n)
+{
+  in_ppu_ = true;
+
+  for (int i = 0; i < n; ++i) {
+    stepDot();
 
-  if (lineTicks_ <= 0) {
-    ++numDrawLines_;
+    if (++lineDots_ >= s_numPixels) {
+      lineDots_ = 0;
 
-    lineTicks_ = ticksPerLine;
+      nextLine();
+
+      // switched to scanline renderer at frame boundary
+      if (renderMode_ != RenderMode::DOT) {
+        lineDots_ = n - i - 1;
+        break;
+      }
+    }
   }
+
+  in_ppu_ = false;
+}
+
+// step current (cpu time) dot: background fetches and shifters, scroll updates,
+// sprite evaluation (dot 257) and pixel output (dots 1-256)
+void
+PPU::
+stepDot()
+{
+  int y   = tickLine_ - s_topMargin; // pixel line (-1 for pre-render line)
+  int dot = lineDots_;
+
+  if (y < -1 || y >= s_visibleLines)
+    return;
+
+  // sprite overflow cleared at start of pre-render line
+  if (y == -1 && dot == 1)
+    spritesOverflow_ = false;
+
+  if (! isRendering()) {
+    if (y >= 0 && dot >= 1 && dot <= s_visiblePixels)
+      drawColorPixel(dot - 1, y, palette(0));
+
+    return;
+  }
+
+  // background fetch (each 8 dots: name, attribute, pattern low/high, next tile)
+  if ((dot >= 2 && dot <= 257) || (dot >= 321 && dot <= 337)) {
+    bgShiftLo_   <<= 1;
+    bgShiftHi_   <<= 1;
+    attrShiftLo_ <<= 1;
+    attrShiftHi_ <<= 1;
+
+    const uchar *page = nameTablePage_[(v_ >> 10) & 0x03];
+
+    switch ((dot - 1) & 0x07) {
+      case 0: {
+        loadBackgroundShifters();
+
+        dotTile_ = page[v_ & 0x03FF];
+
+        break;
+      }
+      case 2: {
+        uchar attr = page[0x03C0 | ((v_ >> 4) & 0x38) | ((v_ >> 2) & 0x07)];
+
+        if (v_ & 0x0040) attr >>= 4;
+        if (v_ & 0x0002) attr >>= 2;
+
+        dotAttr_ = attr & 0x03;
+
+        break;
+      }
+      case 4: {
+        dotPatternLo_ = getVRAMByte(screenPatternAddr_ + dotTile_*16 + (v_ >> 12));
+
+        break;
+      }
+      case 6: {
+        dotPatternHi_ = getVRAMByte(screenPatternAddr_ + dotTile_*16 + (v_ >> 12) + 8);
+
+        break;
+      }
+      case 7: {
+        incrementScrollX();
+
+        break;
+      }
+    }
+  }
+
+  if (dot == 256)
+    incrementScrollY();
+
+  if (dot == 257) {
+    loadBackgroundShifters();
+
+    v_ = (v_ & 0x7BE0) | (t_ & 0x041F);
+
+    if (y + 1 < s_visibleLines)
+      evaluateDotSprites(y + 1);
+  }
+
+  if (y == -1 && dot >= 280 && dot <= 304)
+    v_ = (v_ & 0x041F) | (t_ & 0x7BE0);
+
+  if (y >= 0 && dot >= 1 && dot <= s_visiblePixels)
+    drawDotPixel(dot - 1, y);
+}
+
+void
+PPU::
+loadBackgroundShifters()
+{
+  bgShiftLo_ = (bgShiftLo_ & 0xFF00) | dotPatternLo_;
+  bgShiftHi_ = (bgShiftHi_ & 0xFF00) | dotPatternHi_;
+
+  attrShiftLo_ = (attrShiftLo_ & 0xFF00) | (dotAttr_ & 0x01 ? 0xFF : 0x00);
+  attrShiftHi_ = (attrShiftHi_ & 0xFF00) | (dotAttr_ & 0x02 ? 0xFF : 0x00);
+}
+
+// find first 8 sprites on pixel line (y) and fetch their pattern line
+void
+PPU::
+evaluateDotSprites(int y)
+{
+  int spriteHeight = spriteSize();
+
+  numDotSprites_ = 0;
+
+  for (int spriteNum = 0; spriteNum < 64; ++spriteNum) {
+    int iby = y - (spriteMem_[spriteNum*4] + 1);
+
+    if (iby < 0 || iby >= spriteHeight)
+      continue;
+
+    if (numDotSprites_ == 8) {
+      spritesOverflow_ = true;
+      break;
+    }
+
+    SpriteData spriteData;
+
+    getSpriteData(spriteNum, spriteData);
+
+    ushort p = spritePatternLineAddr(spriteData, iby);
+
+    uchar c1 = getVRAMByte(p    ); // color bit 0
+    uchar c2 = getVRAMByte(p + 8); // color bit 1
+
+    // reverse bits for horizontal flip so bit 7 is always leftmost pixel
+    if (spriteData.flipX) {
+      c1 = reverseBits(c1);
+      c2 = reverseBits(c2);
+    }
+
+    auto &dotSprite = dotSprites_[numDotSprites_++];
+
+    dotSprite.patternLo = c1;
+    dotSprite.patternHi = c2;
+    dotSprite.color     = spriteData.color;
+    dotSprite.behind    = spriteData.behind;
+    dotSprite.zero      = (spriteNum == 0);
+    dotSprite.x         = spriteData.x;
+  }
+}
+
+// combine background and sprite pixel (priority, sprite 0 hit) at (x, y)
+void
+PPU::
+drawDotPixel(int x, int y)
+{
+  uchar bgPixel = 0, bgColor = 0;
+
+  if (screenVisible_ && ! (imageMask_ && x < 8)) {
+    ushort mask = 0x8000 >> fineX_;
+
+    bgPixel = (bgShiftLo_   & mask ? 0x01 : 0) | (bgShiftHi_   & mask ? 0x02 : 0);
+    bgColor = (attrShiftLo_ & mask ? 0x04 : 0) | (attrShiftHi_ & mask ? 0x08 : 0);
+  }
+
+  const DotSprite *sprite = nullptr;
+
+  uchar spritePixel = 0;
+
+  if (spritesVisible_ && ! (spriteMask_ && x < 8)) {
+    for (int i = 0; i < numDotSprites_; ++i) {
+      const auto &dotSprite = dotSprites_[i];
+
+      int ibx = x - dotSprite.x;
+
+      if (ibx < 0 || ibx > 7)
+        continue;
+
+      int bit = 7 - ibx;
+
+      spritePixel = ((dotSprite.patternLo >> bit) & 0x01) |
+                    (((dotSprite.patternHi >> bit) & 0x01) << 1);
+
+      if (spritePixel) {
+        sprite = &dotSprite;
+        break;
+      }
+    }
+  }
+
+  uchar color;
+
+  if      (! bgPixel && ! spritePixel)
+    color = palette(0);
+  else if (! bgPixel)
+    color = spritePalette(spritePixel | sprite->color);
+  else if (! spritePixel)
+    color = palette(bgPixel | bgColor);
+  else {
+    if (sprite->zero && x != 255)
+      spriteHit_ = true;
+
+    if (sprite->behind)
+      color = palette(bgPixel | bgColor);
+    else
+      color = spritePalette(spritePixel | sprite->color);
+  }
+
+  drawColorPixel(x, y, color);
+}
+
+// draw lines up to current cpu time
+void
+PPU::
+drawPendingLines()
+{
+  if (numDrawLines_ <= 0)
+    return;
+
+  for (int i = 0; i < numDrawLines_; ++i) {
+    drawLine(lineNum_++);
+
+    if (lineNum_ >= s_numLines)
+      lineNum_ = 0;
+  }
+
+  numDrawLines_ = 0;
+
+  linesDrawn();
 }
 
 void
@@ -412,25 +892,20 @@ void
 PPU::
 drawLine(int y)
 {
+  CNES_STATS_TIMER(machine_->stats(), PPU_DRAW_LINE);
+  CNES_STATS_COUNT(machine_->stats(), PPU_LINES);
+
   in_ppu_ = true;
 
   scanLineNum_  = y;
   pixelLineNum_ = scanLineNum_ - s_topMargin;
 
-#if 0
-  if (! spriteHit_) {
-    if (isSprite0Hit(scanLineNum_)) {
-      spriteHit_ = true;
+  // decide at first visible line if frame is drawn or skipped
+  if (scanLineNum_ == s_topMargin) {
+    skipFrame_ = (skipCount_ < frameSkip_);
 
-      if (isSpriteInterrupt()) {
-        auto *cpu = machine_->getCPU();
-
-        if (! cpu->isHalt() && ! cpu->inNMI())
-          cpu->resetNMI();
-      }
-    }
+    skipCount_ = (skipFrame_ ? skipCount_ + 1 : 0);
   }
-#endif
 
   // vertical sync
   if      (scanLineNum_ < s_vsyncLines) {
@@ -438,6 +913,17 @@ drawLine(int y)
   // vblank 1
   else if (scanLineNum_ < s_topMargin) {
   }
+  // screen (drawn by dot renderer in cpu time)
+  else if (scanLineNum_ < s_topMargin + s_visibleLines && renderMode_ == RenderMode::DOT &&
+           videoEnabled_) {
+    vblank_ = false;
+  }
+  // screen (not rendered, status flags only)
+  else if (scanLineNum_ < s_topMargin + s_visibleLines && (! videoEnabled_ || skipFrame_)) {
+    vblank_ = false;
+
+    skipLine(pixelLineNum_);
+  }
   // screen
   else if (scanLineNum_ < s_topMargin + s_visibleLines) {
     // NOTE: sprite evaluation starts at line 65 (3 + 14 + 48 ?)
@@ -450,90 +936,65 @@ drawLine(int y)
 
     //---
 
-    int sy  = scrollV_;   // scroll vertical
-    int syb = sy/8;       // scroll vertical bytes
-    int syo = sy - syb*8; // scroll vertical byte pixel offset
-
-    int iy  = pixelLineNum_/8;      // vertical byte index in associated char data
-    int iby = pixelLineNum_ - iy*8; // sub pixel in vertical byte
-
-    int iy1  = iy - syb;  // adjusted vertical byte index in associated char data
-    int iby1 = iby - syo; // adjusted sub pixel in vertical byte
-
-    if (iby1 < 0) {
-      --iy1;
-
-      iby1 = 8 + iby1;
-    }
-
-    //---
-
-    int x = 0;
+    if (isScreenVisible()) {
+      // scroll state at start of line (v register and fine x)
+      ushort v  = lineV_    [pixelLineNum_];
+      int    fx = lineFineX_[pixelLineNum_];
 
-    // hblank 1
-    for (int ix = 0; ix < s_leftMargin; ++ix)
-      ++x;
+      int fineY   = (v & 0x7000) >> 12;
+      int coarseY = (v & 0x03E0) >> 5;
+      int coarseX = (v & 0x001F);
+      int nt      = (v & 0x0C00) >> 10;
 
-    //---
+      // 33 tiles when fine x scroll is non-zero (partial left and right tiles)
+      int nx = (fx > 0 ? s_hChars + 1 : s_hChars);
 
-    int x1 = x - s_leftMargin;
-
-    if (isScreenVisible()) {
-      int sx   = scrollH();  // scroll horizontal
-      int sxb  = sx/8;       // scroll horizontal bytes
-      int sxo  = sx - sxb*8; // scroll horizontal byte pixel offset
-      int isxo = 8 - sxo;    // inverse of scroll horizontal byte pixel offset
+      for (int ix = 0; ix < nx; ++ix) {
+        const uchar *page = nameTablePage_[nt];
 
-      // draw partial left character
-      if (sxo > 0) {
         // get tile number and attribute color
-        uchar c  = calcNameTableTile (iy1, -sxb - 1);
-        uchar ac = calcAttrTableColor(iy1, -sxb - 1);
+        uchar c = page[coarseY*s_hChars + coarseX];
 
-        //---
+        uchar attr  = page[0x03C0 + (coarseY >> 2)*8 + (coarseX >> 2)];
+        int   shift = ((coarseY & 0x02) << 1) | (coarseX & 0x02);
+        uchar ac    = ((attr >> shift) & 0x03) << 2;
 
-        drawCharLine(x1 - isxo, pixelLineNum_, c, ac, iby1, isxo, 8);
-      }
+        //---
 
-      for (int ix = 0; ix < s_hChars; ++ix, x1 += 8) {
-        int ix1 = ix - sxb; // horizontal byte index in associated char data
+        int x   = ix*8 - fx;
+        int ix1 = (ix == 0 ? fx : 0);
+        int ix2 = (ix == nx - 1 && fx > 0 ? fx : 8);
 
-        //---
+        const uchar *span = charLineSpan(c, ac, fineY);
 
-        // get tile number and attribute color
-        uchar c  = calcNameTableTile (iy1, ix1);
-        uchar ac = calcAttrTableColor(iy1, ix1);
+        if (ix2 - ix1 == 8)
+          memcpy(&linePixels_[x], span, 8);
+        else
+          memcpy(&linePixels_[x + ix1], span + ix1, ix2 - ix1);
 
-        //---
+        // next tile (wrap into horizontal name table)
+        if (++coarseX == s_hChars) {
+          coarseX = 0;
 
-        if (ix == 31 && sxo > 0)
-          drawCharLine(x1 + sxo, pixelLineNum_, c, ac, iby1, 0, isxo);
-        else {
-          drawCharLine(x1 + sxo, pixelLineNum_, c, ac, iby1, 0, 8);
+          nt ^= 0x01;
         }
       }
-    }
-    else {
-      // blank line
-      for (int ix = 0; ix < 256; ++ix, ++x1) {
-        if (imageMask_ && ix < 8)
-          continue;
 
-        drawLinePixel(ix, pixelLineNum_, color0_);
-      }
+      // masked left pixels not drawn (line pixels stay background)
+      if (imageMask_)
+        memset(&linePixels_[0], color0_, 8);
     }
 
-    //---
+    // blank line when screen not visible (line pixels already background)
 
-    drawSpritesOnLine(pixelLineNum_);
+    // masked left pixels keep previous screen pixels unless drawn by sprite
+    leftDrawn_ = (imageMask_ ? 0x00 : 0xFF);
 
     //---
 
-    // hblank 2
-    x = x1 + s_leftMargin;
+    drawSpritesOnLine(pixelLineNum_);
 
-    for (int ix = 0; ix < s_rightMargin; ++ix)
-      ++x;
+    outputLine(pixelLineNum_);
   }
   // vblank 2
   else {
@@ -543,6 +1004,13 @@ drawLine(int y)
     if (scanLineNum_ == s_vblankLine) {
     //resetScroll();
 
+      // one change notification per frame
+      machine_->flushChanges();
+
+      lastFrameDamage_ = frameDamage_;
+
+      frameDamage_.reset();
+
       //---
 
       vblank_    = true;
@@ -555,13 +1023,96 @@ drawLine(int y)
           cpu->resetNMI();
       }
     }
+  }
+
+  in_ppu_ = false;
+}
+
+// write composed line pixels to screen. Whole line is compared with previous
+// screen line and only the changed x range is copied and reported as damage
+void
+PPU::
+outputLine(int y)
+{
+  uchar ec   = emphasisBits();
+  uchar mask = (isGrayScale() ? 0x30 : 0xFF);
+
+  ushort *screenPixels = &screenPixels_[y*s_visiblePixels];
 
-    if (scanLineNum_ == s_numLines - 1) {
-      scrollV_ = scrollV();
+  ushort pixels[s_visiblePixels];
+
+  for (int x = 0; x < s_visiblePixels; ++x)
+    pixels[x] = (ec << 8) | (linePixels_[x] & mask);
+
+  if (leftDrawn_ != 0xFF) {
+    for (int x = 0; x < 8; ++x) {
+      if (! (leftDrawn_ & (1 << x)))
+        pixels[x] = screenPixels[x];
     }
   }
 
-  in_ppu_ = false;
+  if (memcmp(pixels, screenPixels, sizeof(pixels)) == 0)
+    return;
+
+  int x1 = 0;
+  int x2 = s_visiblePixels;
+
+  while (pixels[x1] == screenPixels[x1])
+    ++x1;
+
+  while (pixels[x2 - 1] == screenPixels[x2 - 1])
+    --x2;
+
+#ifdef CNES_STATS
+  int nc = 0;
+
+  for (int x = x1; x < x2; ++x)
+    nc += (pixels[x] != screenPixels[x]);
+
+  CNES_STATS_COUNT_N(machine_->stats(), PIXELS_CHANGED, nc);
+#endif
+
+  CNES_STATS_COUNT(machine_->stats(), PPU_LINES_CHANGED);
+
+  memcpy(&screenPixels[x1], &pixels[x1], (x2 - x1)*sizeof(ushort));
+
+  addDamage(y, x1, x2);
+}
+
+// add changed screen pixels x1 to x2 (exclusive) of line y to damage
+void
+PPU::
+addDamage(int y, int x1, int x2)
+{
+  if (lineDamageX1_[y] < lineDamageX2_[y]) {
+    lineDamageX1_[y] = short(std::min(int(lineDamageX1_[y]), x1));
+    lineDamageX2_[y] = short(std::max(int(lineDamageX2_[y]), x2));
+  }
+  else {
+    lineDamageX1_[y] = short(x1);
+    lineDamageX2_[y] = short(x2);
+  }
+
+  damage_     .add(x1, y, x2, y + 1);
+  frameDamage_.add(x1, y, x2, y + 1);
+
+  lineChanged(y, x1, x2);
+}
+
+// reset damage (after frontend has processed changed region)
+void
+PPU::
+clearDamage()
+{
+  if (damage_.isEmpty())
+    return;
+
+  for (int y = damage_.y1; y < damage_.y2; ++y) {
+    lineDamageX1_[y] = 0;
+    lineDamageX2_[y] = 0;
+  }
+
+  damage_.reset();
 }
 
 #if 0
@@ -580,24 +1131,66 @@ void
 PPU::
 drawCharLine(int x, int y, uchar c, uchar ac, uchar iby, uchar ix, uchar nx)
 {
-  int y1 = y - iby; // adjust to top of char
+  const uchar *span = charLineSpan(c, ac, iby);
+
+  for (int ibx = ix; ibx < nx; ++ibx) {
+    if (imageMask_ && x + ibx < 8)
+      continue;
+
+    drawLinePixel(x + ibx, y, span[ibx]);
+  }
+}
+
+// colors of char line at offset (iby) from top of char (c) with attribute color (ac)
+// from direct mapped cache keyed by pattern table, char, line and attribute color
+// (entries tagged with generation which is incremented on CHR or palette change)
+const uchar *
+PPU::
+charLineSpan(uchar c, uchar ac, uchar iby)
+{
+  ulong chrVersion = machine_->getCart()->chrVersion();
+
+  if (chrVersion != spanChrVersion_) {
+    spanChrVersion_ = chrVersion;
+
+    ++spanGeneration_;
+  }
+
+  int bank = (screenPatternAddr_ >> 12) & 0x01;
+
+  ulong key = (spanGeneration_ << 14) | (bank << 13) | (c << 5) | (iby << 2) | (ac >> 2);
+
+  int ind = ((c << 2) ^ (iby << 7) ^ (bank << 9) ^ (ac >> 2)) & (s_spanCacheSize - 1);
+
+  auto &entry = spanCache_[ind];
+
+  if (entry.key == key) {
+    CNES_STATS_COUNT(machine_->stats(), PPU_SPAN_HITS);
+
+    return entry.pixels;
+  }
+
+  CNES_STATS_COUNT(machine_->stats(), PPU_SPAN_MISSES);
+
+  //---
 
   ushort p = screenPatternAddr() + c*16 + iby;
 
   uchar c1 = getVRAMByte(p    ); // color bit 0
   uchar c2 = getVRAMByte(p + 8); // color bit 1
 
-  for (int ibx = ix; ibx < nx; ++ibx) {
-    bool b1 = (c1 & (1 << (7 - ibx)));
-    bool b2 = (c2 & (1 << (7 - ibx)));
-
-    uchar color = palette((b1 | (b2 << 1)) | ac);
+  // background palette entries (same as palette(), $3F00-$3F0F not mirrored)
+  const uchar *colors = &mem_[0x3F00 + ac];
 
-    if (imageMask_ && x + ibx < 8)
-      continue;
+  for (int ibx = 0; ibx < 8; ++ibx) {
+    int b = 7 - ibx;
 
-    drawLinePixel(x + ibx, y1 + iby, color);
+    entry.pixels[ibx] = colors[((c1 >> b) & 1) | (((c2 >> b) & 1) << 1)];
   }
+
+  entry.key = key;
+
+  return entry.pixels;
 }
 
 uchar
@@ -614,9 +1207,7 @@ calcNameTableTile(int iy, int ix) const
 
   assert(offset < 0x03C0);
 
-  ushort nameTableAddr = this->nameTableAddr() + offset;
-
-  return getByte(nameTableAddr); // tile number
+  return nameTablePage_[nameTable_][offset]; // tile number
 }
 
 uchar
@@ -635,9 +1226,7 @@ calcAttrTableColor(int iy, int ix) const
 
   assert(offset < 0x0400);
 
-  ushort attrTableAddr = this->nameTableAddr() + offset;
-
-  uchar ac = getByte(attrTableAddr);
+  uchar ac = nameTablePage_[nameTable_][offset];
 
   uchar ac1 = 0;
 
@@ -722,6 +1311,7 @@ drawSpritesOnLine(int y)
   bool visible = isSpritesVisible();
   if (! visible) return;
 
+  CNES_STATS_TIMER(machine_->stats(), PPU_SPRITES);
   //---
 
   uchar spriteHeight = (isSpriteDoubleHeight() ? 16 : 8);
@@ -746,6 +1336,8 @@ drawSpritesOnLine(int y)
     visibleSprites.push_back(spriteNum);
   }
 
+  CNES_STATS_COUNT_N(machine_->stats(), SPRITES_IN_RANGE, visibleSprites.size());
+
   //----
 
   spritesOverflow_ = false;
@@ -762,6 +1354,158 @@ drawSpritesOnLine(int y)
     drawSpriteLine(spriteNum, y);
 }
 
+// update sprite overflow for line as drawLine would (sprite 0 hit is resolved
+// separately on PPUSTATUS read)
+void
+PPU::
+skipLine(int y)
+{
+  if (! isSpritesVisible())
+    return;
+
+  int spriteHeight = spriteSize();
+
+  int ns = 0;
+
+  for (int spriteNum = 0; spriteNum < 64; ++spriteNum) {
+    int y1 = spriteMem_[4*spriteNum] + 1; // top
+
+    if (y >= y1 && y < y1 + spriteHeight)
+      ++ns;
+  }
+
+  spritesOverflow_ = (ns > 8);
+}
+
+// set sprite 0 hit flag if hit has occurred by current (cpu time) line and dot.
+// Lines are tested once (in order) when first reached, so polling is cheap
+// (scanline render mode, dot renderer sets flag as pixels are drawn)
+void
+PPU::
+resolveSpriteHit()
+{
+  if (spriteHit_ || (renderMode_ == RenderMode::DOT && videoEnabled_))
+    return;
+
+  // only during visible lines and post-render line (flag cleared at vblank)
+  if (tickLine_ < s_topMargin || tickLine_ > s_vblankLine)
+    return;
+
+  int line = std::min(tickLine_ - s_topMargin, s_visibleLines - 1);
+
+  in_ppu_ = true;
+
+  while (hitLine_ < 0 && hitNextLine_ <= line) {
+    int x = spriteHitX(hitNextLine_);
+
+    if (x >= 0) {
+      hitLine_ = hitNextLine_;
+      hitDot_  = x + 1; // pixel x output at dot x + 1
+    }
+
+    ++hitNextLine_;
+  }
+
+  in_ppu_ = false;
+
+  if (hitLine_ < 0)
+    return;
+
+  // dots elapsed in line (hit dot is complete when more than it have elapsed)
+  int dot = (tickLine_ - s_topMargin == hitLine_ ? lineDots_ : s_numPixels);
+
+  if (tickLine_ - s_topMargin > hitLine_ || dot > hitDot_)
+    spriteHit_ = true;
+}
+
+// first pixel of line where sprite 0 opaque pixels overlap opaque background
+// pixels (-1 if none)
+int
+PPU::
+spriteHitX(int y)
+{
+  if (! isSpritesVisible() || ! isScreenVisible())
+    return -1;
+
+  SpriteData spriteData;
+
+  getSpriteData(0, spriteData);
+
+  int y1 = spriteData.y + 1; // top
+
+  if (y < y1 || y >= y1 + spriteSize())
+    return -1;
+
+  uchar mask = spriteLineOpaqueMask(spriteData, y - y1) &
+               backgroundOpaqueMask(y, spriteData.x);
+
+  // first unclipped pixel (not off screen or masked left pixels)
+  for (int ibx = 0; ibx < 8; ++ibx) {
+    int x = spriteData.x + ibx;
+
+    // no hit at x=255 (same as dot renderer)
+    if (x >= s_visiblePixels - 1 || ((spriteMask_ || imageMask_) && x < 8))
+      continue;
+
+    if (mask & (0x80 >> ibx))
+      return x;
+  }
+
+  return -1;
+}
+
+uchar
+PPU::
+spriteLineOpaqueMask(const SpriteData &spriteData, int iby) const
+{
+  ushort p = spritePatternLineAddr(spriteData, iby);
+
+  // non-zero pattern pixels are opaque (bit 7 is leftmost pixel unless flipped)
+  uchar mask = uchar(getVRAMByte(p) | getVRAMByte(p + 8));
+
+  return (spriteData.flipX ? reverseBits(mask) : mask);
+}
+
+// 8 pixels from x (two char line spans of line scroll state)
+uchar
+PPU::
+backgroundOpaqueMask(int y, int x) const
+{
+  ushort v  = lineV_    [y];
+  int    fx = lineFineX_[y];
+
+  int fineY   = (v & 0x7000) >> 12;
+  int coarseY = (v & 0x03E0) >> 5;
+  int coarseX = (v & 0x001F);
+  int nt      = (v & 0x0C00) >> 10;
+
+  int sx = x + fx; // pixel in scrolled tiles
+
+  auto charMask = [&](int ix) {
+    int cx  = coarseX + ix;
+    int cnt = nt;
+
+    while (cx >= s_hChars) {
+      cx -= s_hChars;
+
+      cnt ^= 0x01;
+    }
+
+    uchar c = nameTablePage_[cnt][coarseY*s_hChars + cx];
+
+    ushort p = screenPatternAddr() + c*16 + fineY;
+
+    // non-zero pattern pixels are opaque (bit 7 is leftmost pixel)
+    return uchar(getVRAMByte(p) | getVRAMByte(p + 8));
+  };
+
+  int ix = sx >> 3;
+
+  int mask = (charMask(ix) << 8) | charMask(ix + 1);
+
+  return uchar((mask << (sx & 7)) >> 8);
+}
+
 void
 PPU::
 drawSpriteLine(int spriteNum, int y)
@@ -781,16 +1525,13 @@ drawSpriteLine(int spriteNum, int y)
   in_ppu_ = false;
 }
 
-// draw nth sprite line (iby) for sprite at (x, y) and character (c) and
-// bits 2 and 3 (ac)
-void
+// pattern address of line (iby) of sprite (handles vertical flip and double height)
+ushort
 PPU::
-drawSpriteCharLine(int x, int y, uchar iby, const SpriteData &spriteData)
+spritePatternLineAddr(const SpriteData &spriteData, int iby) const
 {
   bool doubleHeight = (! spriteData.custom ? this->isSpriteDoubleHeight() : false);
 
-  //---
-
   ushort p;
 
   if (! doubleHeight) {
@@ -831,6 +1572,17 @@ drawSpriteCharLine(int x, int y, uchar iby, const SpriteData &spriteData)
     }
   }
 
+  return p;
+}
+
+// draw nth sprite line (iby) for sprite at (x, y) and character (c) and
+// bits 2 and 3 (ac)
+void
+PPU::
+drawSpriteCharLine(int x, int y, uchar iby, const SpriteData &spriteData)
+{
+  ushort p = spritePatternLineAddr(spriteData, iby);
+
   //---
 
   uchar c1 = getVRAMByte(p    ); // color bit 0
@@ -857,18 +1609,9 @@ drawSpriteCharLine(int x, int y, uchar iby, const SpriteData &spriteData)
       if (color == color0_)
         continue;
 
-      bool hit = (linePixels_[x] != color0_);
-
-      if (hit) {
-        if (spriteData.num == 0)
-          spriteHit_ = true;
-
-        if (! spriteData.behind)
-          drawLinePixel(x, y, color);
-      }
-      else {
+      // behind sprites only drawn over background color
+      if (! spriteData.behind || linePixels_[x] == color0_)
         drawLinePixel(x, y, color);
-      }
     }
     else {
       drawCustomColorPixel(x, y, color);
@@ -904,6 +1647,34 @@ getSpriteData(int spriteNum, SpriteData &spriteData) const
   spriteData.y = spriteMem(ispriteAddr + 0);
 }
 
+ulong
+PPU::
+screenHash() const
+{
+  // 4 pixels per step, multiply/rotate mix and final avalanche
+  const ushort *pixels = &screenPixels_[0];
+
+  size_t nw = screenPixels_.size()/4;
+
+  uint64_t h = 0x9E3779B97F4A7C15ULL;
+
+  for (size_t i = 0; i < nw; ++i) {
+    uint64_t w;
+
+    memcpy(&w, pixels + i*4, sizeof(w));
+
+    h ^= w;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h  = (h << 31) | (h >> 33);
+  }
+
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+
+  return ulong(h);
+}
+
 void
 PPU::
 drawLinePixel(int x, int y, uchar color)
@@ -913,7 +1684,8 @@ drawLinePixel(int x, int y, uchar color)
 
   linePixels_[x] = color;
 
-  drawColorPixel(x, y, color);
+  if (x < 8)
+    leftDrawn_ |= (1 << x);
 }
 
 void
@@ -928,102 +1700,40 @@ drawColorPixel(int x, int y, uchar color)
   if (isGrayScale())
     color &= 0x30;
 
-  uchar ec { 0 };
-
-  if (isEmphasizeRed  ()) ec |= 0x01;
-  if (isEmphasizeGreen()) ec |= 0x02;
-  if (isEmphasizeBlue ()) ec |= 0x04;
+  uchar ec = emphasisBits();
 
   ushort pixel = (ec << 8) | color;
 
   if (screenPixels_[ind] != pixel) {
-    screenPixels_[ind] = pixel;
-
-    //---
+    CNES_STATS_COUNT(machine_->stats(), PIXELS_CHANGED);
 
-    setColor(color);
+    screenPixels_[ind] = pixel;
 
-    drawPixel(x + s_leftMargin, y + s_topMargin);
+    addDamage(y, x, x + 1);
   }
 }
 
-void
+// color emphasis bits of screen pixel (red, green, blue)
+uchar
 PPU::
-drawCustomColorPixel(int x, int y, uchar color)
+emphasisBits() const
 {
-  setColor(color);
+  uchar ec { 0 };
 
-  drawPixel(x, y);
+  if (isEmphasizeRed  ()) ec |= 0x01;
+  if (isEmphasizeGreen()) ec |= 0x02;
+  if (isEmphasizeBlue ()) ec |= 0x04;
+
+  return ec;
 }
 
-#if 0
-bool
+void
 PPU::
-isSprite0Hit(int y) const
+drawCustomColorPixel(int x, int y, uchar color)
 {
-  // Sprite 0 hit does not trigger in any area where the background or sprites are hidden
-
-  bool visible = isSpritesVisible();
-
-  if (! visible)
-    return false;
-
-  //---
-
-  SpriteData spriteData;
-
-  getSpriteData(spriteNum, spriteData);
-
-  //---
-
-  bool  doubleHeight = this->isSpriteDoubleHeight();
-  uchar spriteHeight = (doubleHeight ? 16 : 8);
-
-  int y1 = spriteData.y + 1; // top
-  int y2 = y1 + spriteHeight;
-
-  if (y < y1 || y > y2)
-    return false;
-
-  //---
-
-  int x = spriteData.x;
-
-  int iby = y - y1;
-
-  int iby1 = (spriteData.flipY ? spriteHeight - 1 - iby : iby);
-  int iby1 = (spriteData.flipY ? spriteHeight - 1 - iby : iby);
-
-  ushort p;
-
-  if (! doubleHeight) {
-    p = spritePatternAddr() + spriteData.pattern*16 + iby1;
-  }
-  else {
-    if (iby < 8)
-      p = spritePatternAddr() + spriteData.pattern*16 + iby1;
-    else
-      p = spritePatternAltAddr() + spriteData.pattern*16 + iby1 - 8;
-  }
-
-  uchar c1 = getVRAMByte(p    ); // color bit 0
-  uchar c2 = getVRAMByte(p + 8); // color bit 1
-
-  // TODO: flip X ?
-  for (int ibx = 0; ibx < 8; ++ibx) {
-    if (spriteMask_ && x + ibx < 8)
-      continue;
-
-    // get color bits 0 and 1 from sprite pattern
-    bool b1 = (c1 & (1 << (7 - ibx)));
-    bool b2 = (c2 & (1 << (7 - ibx)));
-
-    if (b1 || b2)
-      return true;
-  }
+  setColor(color);
 
-  return false;
+  drawPixel(x, y);
 }
-#endif
 
 }
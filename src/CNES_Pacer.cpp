@@ -0,0 +1,177 @@
+#include <CNES_Pacer.h>
+#include <thread>
+#include <cmath>
+
+namespace CNES {
+
+double
+Pacer::Stats::
+jitter() const
+{
+  return std::sqrt(variance());
+}
+
+//---
+
+Pacer::
+Pacer()
+{
+}
+
+void
+Pacer::
+setMode(Mode mode)
+{
+  if (mode != mode_) {
+    mode_ = mode;
+
+    reset();
+  }
+}
+
+void
+Pacer::
+setSpeed(int speed)
+{
+  speed_ = std::max(speed, 1);
+
+  reset();
+}
+
+void
+Pacer::
+setFrameRate(double r)
+{
+  if (r > 0.0) {
+    frameRate_ = r;
+
+    reset();
+  }
+}
+
+double
+Pacer::
+frameTime() const
+{
+  switch (mode_) {
+    case Mode::REAL_TIME   : return 1.0/frameRate_;
+    case Mode::AUDIO       : return 1.0/frameRate_;
+    case Mode::FAST_FORWARD: return 1.0/(frameRate_*speed_);
+    default                : return 0.0;
+  }
+}
+
+// restart deadlines from current time (and restart stats as target interval changed)
+void
+Pacer::
+reset()
+{
+  started_ = false;
+
+  resetStats();
+}
+
+void
+Pacer::
+resetStats()
+{
+  stats_ = Stats();
+}
+
+void
+Pacer::
+endFrame()
+{
+  auto now = Clock::now();
+
+  if (! started_) {
+    started_  = true;
+    deadline_ = now;
+    lastTime_ = now;
+
+    return;
+  }
+
+  //---
+
+  double frameTime = this->frameTime();
+
+  if      (mode_ == Mode::UNTHROTTLED) {
+  }
+  else if (mode_ == Mode::AUDIO && audioQueued_) {
+    // audio output consumes at real rate so wait until queue drains to target latency
+    // (bounded by two frames in case audio output has stalled)
+    auto timeout = now + std::chrono::duration_cast<Clock::duration>(Duration(2*frameTime));
+
+    while (audioQueued_() > audioLatency_ && Clock::now() < timeout)
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+
+    deadline_ = Clock::now();
+  }
+  else {
+    // absolute deadlines so rounding errors in sleep do not accumulate
+    deadline_ += std::chrono::duration_cast<Clock::duration>(Duration(frameTime));
+
+    // too far behind (debugger pause, slow host) so resync instead of running fast
+    if (now - deadline_ > Duration(4*frameTime)) {
+      deadline_ = now;
+
+      ++stats_.resyncs;
+    }
+    else
+      waitUntil(deadline_);
+  }
+
+  //---
+
+  updateStats(Clock::now());
+}
+
+void
+Pacer::
+waitUntil(const TimePoint &t) const
+{
+  // sleep for bulk of wait then yield for remainder (sleep granularity is coarse)
+  static const auto spinTime = std::chrono::microseconds(1000);
+
+  auto now = Clock::now();
+
+  if (t - now > spinTime)
+    std::this_thread::sleep_until(t - spinTime);
+
+  while (Clock::now() < t)
+    std::this_thread::yield();
+}
+
+void
+Pacer::
+updateStats(const TimePoint &t)
+{
+  double dt = Duration(t - lastTime_).count();
+
+  lastTime_ = t;
+
+  // Welford running mean/variance
+  ++stats_.frames;
+
+  double delta = dt - stats_.mean;
+
+  stats_.mean += delta/stats_.frames;
+  stats_.m2   += delta*(dt - stats_.mean);
+
+  if (stats_.frames == 1) {
+    stats_.minTime = dt;
+    stats_.maxTime = dt;
+  }
+  else {
+    stats_.minTime = std::min(stats_.minTime, dt);
+    stats_.maxTime = std::max(stats_.maxTime, dt);
+  }
+
+  double frameTime = this->frameTime();
+
+  if (frameTime > 0.0)
+    stats_.maxDev = std::max(stats_.maxDev, std::abs(dt - frameTime));
+}
+
+}
@@ -0,0 +1,390 @@
+#include <CNES_Palette.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CNES_PALETTE_AVX2 1
+#endif
+
+namespace CNES {
+
+namespace {
+
+// NES palette (same as QPPU)
+const uchar s_paletteRGB[64][3] = {
+  { 84,  84,  84}, {  0,  30, 116}, {  8,  16, 144}, { 48,   0, 136},
+  { 68,   0, 100}, { 92,   0,  48}, { 84,   4,   0}, { 60,  24,   0},
+  { 32,  42,   0}, {  8,  58,   0}, {  0,  64,   0}, {  0,  60,   0},
+  {  0,  50,  60}, {  0,   0,   0}, {  0,   0,   0}, {  0,   0,   0},
+
+  {152, 150, 152}, {  8,  76, 196}, { 48,  50, 236}, { 92,  30, 228},
+  {136,  20, 176}, {160,  20, 100}, {152,  34,  32}, {120,  60,   0},
+  { 84,  90,   0}, { 40, 114,   0}, {  8, 124,   0}, {  0, 118,  40},
+  {  0, 102, 120}, {  0,   0,   0}, {  0,   0,   0}, {  0,   0,   0},
+
+  {236, 238, 236}, { 76, 154, 236}, {120, 124, 236}, {176,  98, 236},
+  {228,  84, 236}, {236,  88, 180}, {236, 106, 100}, {212, 136,  32},
+  {160, 170,   0}, {116, 196,   0}, { 76, 208,  32}, { 56, 204, 108},
+  { 56, 180, 204}, { 60,  60,  60}, {  0,   0,   0}, {  0,   0,   0},
+
+  {236, 238, 236}, {168, 204, 236}, {188, 188, 236}, {212, 178, 236},
+  {236, 174, 236}, {236, 174, 212}, {236, 180, 176}, {228, 196, 144},
+  {204, 210, 120}, {180, 222, 120}, {168, 226, 144}, {152, 226, 180},
+  {160, 214, 228}, {160, 162, 160}, {  0,   0,   0}, {  0,   0,   0},
+};
+
+// lookup tables indexed by emphasis*64 + palette index
+struct Tables {
+  uchar rgb   [512][3];
+  uint  rgba  [512]; // bytes R, G, B, A
+  uint  bgra  [512]; // bytes B, G, R, A
+  uint  rgb565[512]; // 16 bit value (32 bit entries for gather)
+
+  Tables();
+};
+
+// HSV value (0-65535) scaled by factor (percent) and back to RGB, matching
+// QColor::lighter (factor > 100) and QColor::darker (100*100/factor)
+void
+scaleValue(const uchar rgb[3], int factor, bool lighter, uchar rgb1[3])
+{
+  const float m = 65535.0f;
+
+  float r = rgb[0]*257/m;
+  float g = rgb[1]*257/m;
+  float b = rgb[2]*257/m;
+
+  float max   = std::max(r, std::max(g, b));
+  float min   = std::min(r, std::min(g, b));
+  float delta = max - min;
+
+  int  hue = -1;
+  int  s   = 0;
+  uint v   = uint(std::lround(max*m));
+
+  if (delta > 0.0f) {
+    s = int(std::lround((delta/max)*m));
+
+    float h;
+
+    if      (r == max) h = (g - b)/delta;
+    else if (g == max) h = 2.0f + (b - r)/delta;
+    else               h = 4.0f + (r - g)/delta;
+
+    h *= 60.0f;
+
+    if (h < 0.0f)
+      h += 360.0f;
+
+    hue = int(std::lround(h*100.0f));
+  }
+
+  if (lighter) {
+    v = (factor*v)/100;
+
+    if (v > 65535) {
+      s -= int(v - 65535);
+
+      if (s < 0)
+        s = 0;
+
+      v = 65535;
+    }
+  }
+  else
+    v = (v*100)/factor;
+
+  float rf, gf, bf;
+
+  if (s == 0 || hue < 0) {
+    rf = gf = bf = v/m;
+  }
+  else {
+    float h  = (hue == 36000 ? 0.0f : hue/6000.0f);
+    float sf = s/m;
+    float vf = v/m;
+    int   i  = int(h);
+    float f  = h - i;
+    float p  = vf*(1.0f - sf);
+
+    if (i & 1) {
+      float q = vf*(1.0f - sf*f);
+
+      if      (i == 1) { rf = q ; gf = vf; bf = p ; }
+      else if (i == 3) { rf = p ; gf = q ; bf = vf; }
+      else             { rf = vf; gf = p ; bf = q ; }
+    }
+    else {
+      float t = vf*(1.0f - sf*(1.0f - f));
+
+      if      (i == 0) { rf = vf; gf = t ; bf = p ; }
+      else if (i == 2) { rf = p ; gf = vf; bf = t ; }
+      else             { rf = t ; gf = p ; bf = vf; }
+    }
+  }
+
+  rgb1[0] = uchar(std::lround(rf*m) >> 8);
+  rgb1[1] = uchar(std::lround(gf*m) >> 8);
+  rgb1[2] = uchar(std::lround(bf*m) >> 8);
+}
+
+Tables::
+Tables()
+{
+  // emphasis bits (red 0x01, green 0x02, blue 0x04) lighten emphasized channels
+  // and darken the others (same as QPPU)
+  for (int ic = 0; ic < 64; ++ic) {
+    const uchar *color = s_paletteRGB[ic];
+
+    uchar color1[3], color2[3];
+
+    scaleValue(color, 150, true , color1);
+    scaleValue(color, 200, false, color2);
+
+    for (int ie = 0; ie < 8; ++ie) {
+      uchar *rgb = this->rgb[ie*64 + ic];
+
+      for (int j = 0; j < 3; ++j)
+        rgb[j] = (ie == 0 ? color[j] : ((ie & (1 << j)) ? color1[j] : color2[j]));
+    }
+  }
+
+  for (int i = 0; i < 512; ++i) {
+    const uchar *c = rgb[i];
+
+    uchar rgba[4] = { c[0], c[1], c[2], 0xFF };
+    uchar bgra[4] = { c[2], c[1], c[0], 0xFF };
+
+    memcpy(&this->rgba[i], rgba, 4);
+    memcpy(&this->bgra[i], bgra, 4);
+
+    rgb565[i] = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+  }
+}
+
+const Tables &
+tables()
+{
+  static Tables tables;
+
+  return tables;
+}
+
+// table index of screen pixel
+inline int
+pixelIndex(ushort pixel)
+{
+  return ((pixel >> 2) & 0x1C0) | (pixel & 0x3F);
+}
+
+bool
+simdSupported()
+{
+#ifdef CNES_PALETTE_AVX2
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+bool s_simd = simdSupported();
+
+//---
+
+void
+convertLine8(const ushort *pixels, int n, uchar *dest)
+{
+  for (int i = 0; i < n; ++i)
+    dest[i] = uchar(pixels[i] & 0x3F);
+}
+
+void
+convertLine32(const ushort *pixels, int n, const uint *lut, uchar *dest)
+{
+  for (int i = 0; i < n; ++i)
+    memcpy(dest + 4*i, &lut[pixelIndex(pixels[i])], 4);
+}
+
+void
+convertLine16(const ushort *pixels, int n, const uint *lut, uchar *dest)
+{
+  for (int i = 0; i < n; ++i) {
+    ushort c = ushort(lut[pixelIndex(pixels[i])]);
+
+    memcpy(dest + 2*i, &c, 2);
+  }
+}
+
+#ifdef CNES_PALETTE_AVX2
+// table indices of 8 pixels as 32 bit lanes
+__attribute__((target("avx2")))
+inline __m256i
+pixelIndices8(const ushort *pixels)
+{
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+
+  __m128i e = _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi16(0x1C0));
+  __m128i c = _mm_and_si128(v, _mm_set1_epi16(0x3F));
+
+  return _mm256_cvtepu16_epi32(_mm_or_si128(e, c));
+}
+
+// 8 pixels per gather
+__attribute__((target("avx2")))
+void
+convertLine32AVX2(const ushort *pixels, int n, const uint *lut, uchar *dest)
+{
+  const int *lut1 = reinterpret_cast<const int *>(lut);
+
+  int i = 0;
+
+  for ( ; i + 8 <= n; i += 8) {
+    __m256i c = _mm256_i32gather_epi32(lut1, pixelIndices8(pixels + i), 4);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + 4*i), c);
+  }
+
+  convertLine32(pixels + i, n - i, lut, dest + 4*i);
+}
+
+// 16 pixels per step (two gathers packed to 16 bit, packs work per 128 bit lane
+// so reorder 64 bit quarters)
+__attribute__((target("avx2")))
+void
+convertLine16AVX2(const ushort *pixels, int n, const uint *lut, uchar *dest)
+{
+  const int *lut1 = reinterpret_cast<const int *>(lut);
+
+  int i = 0;
+
+  for ( ; i + 16 <= n; i += 16) {
+    __m256i c1 = _mm256_i32gather_epi32(lut1, pixelIndices8(pixels + i    ), 4);
+    __m256i c2 = _mm256_i32gather_epi32(lut1, pixelIndices8(pixels + i + 8), 4);
+
+    __m256i c = _mm256_permute4x64_epi64(_mm256_packus_epi32(c1, c2), 0xD8);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + 2*i), c);
+  }
+
+  convertLine16(pixels + i, n - i, lut, dest + 2*i);
+}
+
+// 32 pixels per step (palette index only, no lookup)
+__attribute__((target("avx2")))
+void
+convertLine8AVX2(const ushort *pixels, int n, uchar *dest)
+{
+  const __m256i mask = _mm256_set1_epi16(0x3F);
+
+  int i = 0;
+
+  for ( ; i + 32 <= n; i += 32) {
+    __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i     ));
+    __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i + 16));
+
+    __m256i c = _mm256_packus_epi16(_mm256_and_si256(v1, mask), _mm256_and_si256(v2, mask));
+
+    c = _mm256_permute4x64_epi64(c, 0xD8);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i), c);
+  }
+
+  convertLine8(pixels + i, n - i, dest + i);
+}
+#endif
+
+}
+
+//---
+
+void
+Palette::
+rgb(ushort pixel, uchar &r, uchar &g, uchar &b)
+{
+  const uchar *c = tables().rgb[pixelIndex(pixel)];
+
+  r = c[0]; g = c[1]; b = c[2];
+}
+
+int
+Palette::
+bytesPerPixel(Format format)
+{
+  switch (format) {
+    case Format::RGBA8888: return 4;
+    case Format::BGRA8888: return 4;
+    case Format::RGB565  : return 2;
+    case Format::INDEXED8: return 1;
+    default              : return 0;
+  }
+}
+
+void
+Palette::
+convert(const ushort *pixels, int w, int h, int pixelStride, Format format,
+        uchar *dest, int destStride)
+{
+  for (int y = 0; y < h; ++y)
+    convertLine(pixels + y*pixelStride, w, format, dest + y*destStride);
+}
+
+void
+Palette::
+convertLine(const ushort *pixels, int n, Format format, uchar *dest)
+{
+  const auto &tables = CNES::tables();
+
+#ifdef CNES_PALETTE_AVX2
+  if (s_simd) {
+    switch (format) {
+      case Format::RGBA8888: convertLine32AVX2(pixels, n, tables.rgba  , dest); return;
+      case Format::BGRA8888: convertLine32AVX2(pixels, n, tables.bgra  , dest); return;
+      case Format::RGB565  : convertLine16AVX2(pixels, n, tables.rgb565, dest); return;
+      case Format::INDEXED8: convertLine8AVX2 (pixels, n, dest); return;
+      default              : break;
+    }
+  }
+#endif
+
+  switch (format) {
+    case Format::RGBA8888: convertLine32(pixels, n, tables.rgba  , dest); break;
+    case Format::BGRA8888: convertLine32(pixels, n, tables.bgra  , dest); break;
+    case Format::RGB565  : convertLine16(pixels, n, tables.rgb565, dest); break;
+    case Format::INDEXED8: convertLine8 (pixels, n, dest); break;
+    default              : break;
+  }
+}
+
+void
+Palette::
+colorTable(uchar emphasis, Format format, uchar *dest)
+{
+  ushort pixels[64];
+
+  for (int i = 0; i < 64; ++i)
+    pixels[i] = ushort(((emphasis & 0x07) << 8) | i);
+
+  // indexed colors are RGBA
+  if (format == Format::INDEXED8)
+    format = Format::RGBA8888;
+
+  convertLine(pixels, 64, format, dest);
+}
+
+bool
+Palette::
+isSIMD()
+{
+  return s_simd;
+}
+
+void
+Palette::
+setSIMD(bool b)
+{
+  s_simd = (b && simdSupported());
+}
+
+}
@@ -0,0 +1,419 @@
+#include <CNES_Profiler.h>
+#include <CNES_Machine.h>
+#include <CNES_CPU.h>
+#include <CNES_Cartridge.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+
+namespace CNES {
+
+const ulong Profiler::s_never;
+const uint  Profiler::s_nmiKey;
+
+Profiler::
+Profiler(Machine *machine) :
+ machine_(machine)
+{
+}
+
+void
+Profiler::
+start(uint interval, bool callStacks)
+{
+  interval_   = std::max(interval, 2U);
+  callStacks_ = callStacks;
+  enabled_    = true;
+
+  stack_.clear();
+
+  lostDepth_ = 0;
+
+  auto *cpu = machine_->getCPU();
+
+  sampleTime_ = (cpu ? cpu->cycles() : 0) + interval_;
+}
+
+void
+Profiler::
+stop()
+{
+  enabled_    = false;
+  sampleTime_ = s_never;
+}
+
+void
+Profiler::
+clear()
+{
+  counts_     .clear();
+  stackCounts_.clear();
+
+  numSamples_ = 0;
+}
+
+void
+Profiler::
+sample(ulong cycle, ushort pc)
+{
+  if (! enabled_)
+    return;
+
+  uint key = makeKey(pc);
+
+  ++counts_[key];
+
+  ++numSamples_;
+
+  if (callStacks_) {
+    Stack stack = stack_;
+
+    stack.push_back(key);
+
+    ++stackCounts_[stack];
+  }
+
+  // next sample in [interval/2, 3*interval/2) cycles (LCG jitter)
+  seed_ = seed_*1103515245 + 12345;
+
+  sampleTime_ = cycle + interval_/2 + (seed_ >> 8) % interval_;
+}
+
+void
+Profiler::
+traceInstruction(ushort pc, uchar opcode, bool nmi)
+{
+  // JSR (target from operand as NMI may have been taken after it)
+  if      (opcode == 0x20) {
+    auto *cpu = machine_->getCPU();
+
+    ushort target = ushort(cpu->opcodeByte(pc + 1) | (cpu->opcodeByte(pc + 2) << 8));
+
+    if (int(stack_.size()) < s_maxDepth)
+      stack_.push_back(makeKey(target));
+    else
+      ++lostDepth_;
+  }
+  // RTS
+  else if (opcode == 0x60) {
+    if      (lostDepth_ > 0)
+      --lostDepth_;
+    else if (! stack_.empty() && stack_.back() != s_nmiKey)
+      stack_.pop_back();
+  }
+  // RTI (unwind to interrupt)
+  else if (opcode == 0x40) {
+    auto p = std::find(stack_.rbegin(), stack_.rend(), s_nmiKey);
+
+    if (p != stack_.rend()) {
+      stack_.erase((p + 1).base(), stack_.end());
+
+      lostDepth_ = 0;
+    }
+  }
+
+  if (nmi)
+    stack_.push_back(s_nmiKey);
+}
+
+uint
+Profiler::
+makeKey(ushort addr) const
+{
+  auto *cart = machine_->getCart();
+
+  int bank = (cart ? cart->prgBank(addr) : -1);
+
+  return (uint(bank + 1) << 16) | addr;
+}
+
+//---
+
+bool
+Profiler::
+loadLabels(const std::string &filename)
+{
+  std::ifstream is(filename);
+  if (! is) return false;
+
+  auto parseHex = [](const std::string &str, long &value) {
+    std::string str1 = str;
+
+    if (! str1.empty() && str1[0] == '$')
+      str1 = str1.substr(1);
+
+    if (str1.empty())
+      return false;
+
+    char *end;
+
+    value = std::strtol(str1.c_str(), &end, 16);
+
+    return (*end == '\0');
+  };
+
+  std::string line;
+
+  while (std::getline(is, line)) {
+    auto p = line.find(';');
+
+    if (p != std::string::npos)
+      line = line.substr(0, p);
+
+    // FCEUX: $addr#name#comment
+    if (! line.empty() && line[0] == '$' && line.find('#') != std::string::npos) {
+      auto p1 = line.find('#');
+      auto p2 = line.find('#', p1 + 1);
+
+      long addr;
+
+      if (parseHex(line.substr(0, p1), addr))
+        addLabel(-1, ushort(addr), line.substr(p1 + 1, p2 - p1 - 1));
+
+      continue;
+    }
+
+    std::istringstream ls(line);
+
+    std::vector<std::string> words;
+
+    std::string word;
+
+    while (ls >> word)
+      words.push_back(word);
+
+    if (words.size() < 2)
+      continue;
+
+    long addr;
+
+    // VICE (ca65 -Ln): al addr .name
+    if      (words[0] == "al" && words.size() >= 3) {
+      if (parseHex(words[1], addr)) {
+        std::string name = words[2];
+
+        if (! name.empty() && name[0] == '.')
+          name = name.substr(1);
+
+        addLabel(-1, ushort(addr & 0xFFFF), name);
+      }
+    }
+    // name = $addr
+    else if (words.size() >= 3 && words[1] == "=") {
+      if (parseHex(words[2], addr))
+        addLabel(-1, ushort(addr), words[0]);
+    }
+    // [bank:]addr name
+    else {
+      int  bank = -1;
+      auto p1   = words[0].find(':');
+
+      long bank1;
+
+      if (p1 != std::string::npos) {
+        if (! parseHex(words[0].substr(0, p1), bank1))
+          continue;
+
+        bank = int(bank1);
+
+        words[0] = words[0].substr(p1 + 1);
+      }
+
+      if (parseHex(words[0], addr))
+        addLabel(bank, ushort(addr), words[1]);
+    }
+  }
+
+  return true;
+}
+
+void
+Profiler::
+addLabel(int bank, ushort addr, const std::string &name)
+{
+  labels_[bank][addr] = name;
+}
+
+// nearest label at or before address (in key's bank or any bank)
+const std::string *
+Profiler::
+findLabel(uint key, int &offset) const
+{
+  int    bank = keyBank(key);
+  ushort addr = keyAddr(key);
+
+  const std::string *name = nullptr;
+
+  auto findBankLabel = [&](int bank1) {
+    auto pb = labels_.find(bank1);
+    if (pb == labels_.end()) return;
+
+    const auto &addrLabels = (*pb).second;
+
+    auto pa = addrLabels.upper_bound(addr);
+    if (pa == addrLabels.begin()) return;
+
+    --pa;
+
+    int offset1 = addr - (*pa).first;
+
+    if (! name || offset1 < offset) {
+      name   = &(*pa).second;
+      offset = offset1;
+    }
+  };
+
+  if (bank >= 0)
+    findBankLabel(bank);
+
+  findBankLabel(-1);
+
+  return name;
+}
+
+std::string
+Profiler::
+symbolName(uint key) const
+{
+  if (key == s_nmiKey)
+    return "NMI";
+
+  int offset = 0;
+
+  auto *name = findLabel(key, offset);
+
+  std::ostringstream os;
+
+  if (name) {
+    os << *name;
+
+    if (offset > 0)
+      os << "+" << offset;
+  }
+  else {
+    int bank = keyBank(key);
+
+    if (bank >= 0)
+      os << std::hex << std::setw(2) << std::setfill('0') << bank << ":";
+
+    os << std::hex << std::setw(4) << std::setfill('0') << keyAddr(key);
+  }
+
+  return os.str();
+}
+
+std::string
+Profiler::
+functionName(uint key) const
+{
+  if (key == s_nmiKey)
+    return "NMI";
+
+  int offset = 0;
+
+  auto *name = findLabel(key, offset);
+
+  if (name)
+    return *name;
+
+  return symbolName(key);
+}
+
+//---
+
+void
+Profiler::
+writeReport(std::ostream &os) const
+{
+  double total = std::max(double(numSamples_), 1.0);
+
+  auto writeLine = [&](ulong count, const std::string &str) {
+    os << std::setw(9) << std::dec << count << " " <<
+          std::setw(6) << std::fixed << std::setprecision(2) << 100.0*count/total << "% " <<
+          str << "\n";
+  };
+
+  os << "Samples: " << numSamples_ << " (every ~" << interval_ << " cycles)\n";
+
+  //---
+
+  // per function (nearest label)
+  std::map<std::string, ulong> functionCounts;
+
+  for (const auto &pc : counts_)
+    functionCounts[functionName(pc.first)] += pc.second;
+
+  std::vector<std::pair<ulong, std::string>> functions;
+
+  for (const auto &pf : functionCounts)
+    functions.push_back(std::make_pair(pf.second, pf.first));
+
+  std::sort(functions.rbegin(), functions.rend());
+
+  os << "\nFunctions\n";
+
+  for (const auto &f : functions)
+    writeLine(f.first, f.second);
+
+  //---
+
+  // per address
+  std::vector<std::pair<ulong, uint>> addrs;
+
+  for (const auto &pc : counts_)
+    addrs.push_back(std::make_pair(pc.second, pc.first));
+
+  std::sort(addrs.rbegin(), addrs.rend());
+
+  os << "\nAddresses\n";
+
+  for (const auto &a : addrs) {
+    std::ostringstream ss;
+
+    int bank = keyBank(a.second);
+
+    if (bank >= 0)
+      ss << std::hex << std::setw(2) << std::setfill('0') << bank << ":";
+    else
+      ss << "--:";
+
+    ss << std::hex << std::setw(4) << std::setfill('0') << keyAddr(a.second) <<
+          " " << symbolName(a.second);
+
+    writeLine(a.first, ss.str());
+  }
+}
+
+void
+Profiler::
+writeCollapsed(std::ostream &os) const
+{
+  // merge stacks with same names
+  std::map<std::string, ulong> lines;
+
+  for (const auto &ps : stackCounts_) {
+    std::string line = "main";
+    std::string lastName;
+
+    for (const auto &key : ps.first) {
+      auto name = functionName(key);
+
+      // leaf (sampled pc) in called function is same frame
+      if (&key == &ps.first.back() && name == lastName)
+        break;
+
+      line += ";" + name;
+
+      lastName = name;
+    }
+
+    lines[line] += ps.second;
+  }
+
+  for (const auto &pl : lines)
+    os << pl.first << " " << pl.second << "\n";
+}
+
+}
@@ -0,0 +1,227 @@
+#include <CNES_SoundLog.h>
+#include <chrono>
+#include <cstring>
+
+namespace CNES {
+
+SoundLog::
+SoundLog(uint size) :
+ ring_(size)
+{
+  std::memset(regs_, 0, sizeof(regs_));
+}
+
+SoundLog::
+~SoundLog()
+{
+  close(startCycle_);
+}
+
+bool
+SoundLog::
+open(const std::string &filename, ulong cycle, double clockRate)
+{
+  close(cycle);
+
+  fp_ = fopen(filename.c_str(), "wb");
+  if (! fp_) return false;
+
+  startCycle_ = cycle;
+  clockRate_  = clockRate;
+  numSamples_ = 0;
+  numDropped_ = 0;
+
+  // header is written on close (when sizes are known)
+  for (int i = 0; i < s_headerSize; ++i)
+    writeByte(0);
+
+  logState(cycle);
+
+  isOpen_  = true;
+  running_ = true;
+
+  thread_ = std::thread(&SoundLog::writeThread, this);
+
+  return true;
+}
+
+// log current register values so playback starts in the same state
+void
+SoundLog::
+logState(ulong cycle)
+{
+  Event event;
+
+  event.cycle = cycle;
+
+  auto addEvent = [&](ushort addr) {
+    event.addr  = addr;
+    event.value = regs_[addr & 0x1F];
+
+    ring_.write(&event, 1);
+  };
+
+  addEvent(0x4015);
+  addEvent(0x4017);
+
+  for (ushort addr = 0x4000; addr <= 0x4013; ++addr)
+    addEvent(addr);
+}
+
+void
+SoundLog::
+close(ulong cycle)
+{
+  if (! fp_)
+    return;
+
+  isOpen_ = false;
+
+  running_ = false;
+
+  if (thread_.joinable())
+    thread_.join();
+
+  // remaining events
+  writeEvents();
+
+  if (cycle > startCycle_)
+    writeWait(cycle);
+
+  writeByte(0x66); // end of sound data
+
+  writeHeader();
+
+  fclose(fp_);
+
+  fp_ = nullptr;
+}
+
+void
+SoundLog::
+writeThread()
+{
+  while (running_) {
+    writeEvents();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+
+void
+SoundLog::
+writeEvents()
+{
+  static const uint s_chunkSize = 256;
+
+  Event events[s_chunkSize];
+
+  uint n;
+
+  while ((n = ring_.read(events, s_chunkSize)) > 0) {
+    for (uint i = 0; i < n; ++i) {
+      const auto &event = events[i];
+
+      writeWait(event.cycle);
+
+      // NES APU register write (register offset from $4000)
+      writeByte(0xB4);
+      writeByte(uchar(event.addr - 0x4000));
+      writeByte(event.value);
+    }
+  }
+}
+
+// wait until sample position of cpu cycle
+void
+SoundLog::
+writeWait(ulong cycle)
+{
+  if (cycle < startCycle_)
+    return;
+
+  auto pos = ulong(double(cycle - startCycle_)*s_vgmRate/clockRate_);
+
+  if (pos <= numSamples_)
+    return;
+
+  ulong n = pos - numSamples_;
+
+  numSamples_ = pos;
+
+  while (n > 0) {
+    if      (n <= 16) {
+      writeByte(uchar(0x70 + n - 1)); // wait n+1 samples
+
+      n = 0;
+    }
+    else if (n == 735) {
+      writeByte(0x62); // wait 1/60th second
+
+      n = 0;
+    }
+    else if (n == 882) {
+      writeByte(0x63); // wait 1/50th second
+
+      n = 0;
+    }
+    else {
+      ushort n1 = ushort(std::min(n, ulong(0xFFFF)));
+
+      writeByte(0x61);
+      writeWord(n1);
+
+      n -= n1;
+    }
+  }
+}
+
+void
+SoundLog::
+writeByte(uchar c)
+{
+  fputc(c, fp_);
+}
+
+void
+SoundLog::
+writeWord(ushort s)
+{
+  fputc(s & 0xFF, fp_);
+  fputc((s >> 8) & 0xFF, fp_);
+}
+
+void
+SoundLog::
+writeHeader()
+{
+  long fileSize = ftell(fp_);
+
+  uchar header[s_headerSize];
+
+  std::memset(header, 0, sizeof(header));
+
+  auto setLong = [&](int pos, uint l) {
+    header[pos    ] = uchar( l        & 0xFF);
+    header[pos + 1] = uchar((l >>  8) & 0xFF);
+    header[pos + 2] = uchar((l >> 16) & 0xFF);
+    header[pos + 3] = uchar((l >> 24) & 0xFF);
+  };
+
+  header[0] = 'V'; header[1] = 'g'; header[2] = 'm'; header[3] = ' ';
+
+  setLong(0x04, uint(fileSize - 0x04));       // EOF offset
+  setLong(0x08, 0x00000161);                  // version 1.61
+  setLong(0x18, uint(numSamples_));           // total samples
+  setLong(0x24, 60);                          // rate (NTSC)
+  setLong(0x34, s_headerSize - 0x34);         // VGM data offset
+  setLong(0x84, uint(clockRate_ + 0.5));      // NES APU clock
+
+  fseek(fp_, 0, SEEK_SET);
+
+  fwrite(header, 1, sizeof(header), fp_);
+
+  fseek(fp_, 0, SEEK_END);
+}
+
+}
@@ -0,0 +1,173 @@
+#include <CNES_Stats.h>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+namespace CNES {
+
+double
+Stats::
+ticksPerSecond()
+{
+  // calibrate time stamp counter against steady clock once
+  static double tps = []() {
+    auto t1 = std::chrono::steady_clock::now();
+    auto c1 = ticks();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto t2 = std::chrono::steady_clock::now();
+    auto c2 = ticks();
+
+    double s = std::chrono::duration<double>(t2 - t1).count();
+
+    return (s > 0.0 ? double(c2 - c1)/s : 1e9);
+  }();
+
+  return tps;
+}
+
+Stats::
+Stats()
+{
+}
+
+bool
+Stats::
+isEnabled()
+{
+#ifdef CNES_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+Stats::
+endFrame()
+{
+  last_ = frame_;
+
+  for (int i = 0; i < s_numCounters; ++i)
+    total_.counters[i] += frame_.counters[i];
+
+  for (int i = 0; i < s_numTimers; ++i) {
+    total_.timers[i].ticks += frame_.timers[i].ticks;
+    total_.timers[i].calls += frame_.timers[i].calls;
+  }
+
+  frame_.clear();
+
+  ++numFrames_;
+}
+
+void
+Stats::
+reset()
+{
+  frame_.clear();
+  last_ .clear();
+  total_.clear();
+
+  numFrames_ = 0;
+}
+
+double
+Stats::
+frameTime(Timer timer) const
+{
+  auto ticks = last_.timers[int(timer)].ticks;
+
+  return (ticks ? ticks/ticksPerSecond() : 0.0);
+}
+
+double
+Stats::
+totalTime(Timer timer) const
+{
+  auto ticks = total_.timers[int(timer)].ticks;
+
+  return (ticks ? ticks/ticksPerSecond() : 0.0);
+}
+
+const char *
+Stats::
+counterName(Counter counter)
+{
+  switch (counter) {
+    case Counter::INSTRUCTIONS     : return "instructions";
+    case Counter::READ_RAM         : return "read_ram";
+    case Counter::READ_IO          : return "read_io";
+    case Counter::READ_EXPANSION   : return "read_expansion";
+    case Counter::READ_CART_RAM    : return "read_cart_ram";
+    case Counter::READ_ROM         : return "read_rom";
+    case Counter::WRITE_RAM        : return "write_ram";
+    case Counter::WRITE_IO         : return "write_io";
+    case Counter::WRITE_EXPANSION  : return "write_expansion";
+    case Counter::WRITE_CART_RAM   : return "write_cart_ram";
+    case Counter::WRITE_ROM        : return "write_rom";
+    case Counter::PPU_LINES        : return "ppu_lines";
+    case Counter::SPRITES_IN_RANGE : return "sprites_in_range";
+    case Counter::PIXELS_CHANGED   : return "pixels_changed";
+    case Counter::PPU_LINES_CHANGED: return "ppu_lines_changed";
+    case Counter::PPU_SPAN_HITS    : return "ppu_span_hits";
+    case Counter::PPU_SPAN_MISSES  : return "ppu_span_misses";
+    default                        : return "";
+  }
+}
+
+const char *
+Stats::
+timerName(Timer timer)
+{
+  switch (timer) {
+    case Timer::CPU_STEP     : return "cpu_step";
+    case Timer::PPU_DRAW_LINE: return "ppu_draw_line";
+    case Timer::PPU_SPRITES  : return "ppu_sprites";
+    case Timer::FRONTEND_DRAW: return "frontend_draw";
+    case Timer::EVENTS       : return "events";
+    default                  : return "";
+  }
+}
+
+std::string
+Stats::
+toJSON() const
+{
+  std::ostringstream os;
+
+  os << "{\n";
+  os << "  \"enabled\": " << (isEnabled() ? "true" : "false") << ",\n";
+  os << "  \"frames\": " << numFrames_ << ",\n";
+
+  os << "  \"counters\": {\n";
+
+  for (int i = 0; i < s_numCounters; ++i) {
+    auto counter = Counter(i);
+
+    os << "    \"" << counterName(counter) << "\": { \"frame\": " << frameCount(counter) <<
+          ", \"total\": " << totalCount(counter) << " }" <<
+          (i < s_numCounters - 1 ? "," : "") << "\n";
+  }
+
+  os << "  },\n";
+
+  os << "  \"timers\": {\n";
+
+  for (int i = 0; i < s_numTimers; ++i) {
+    auto timer = Timer(i);
+
+    os << "    \"" << timerName(timer) << "\": { \"frame_ms\": " << 1000.0*frameTime(timer) <<
+          ", \"total_ms\": " << 1000.0*totalTime(timer) <<
+          ", \"calls\": " << totalCalls(timer) << " }" <<
+          (i < s_numTimers - 1 ? "," : "") << "\n";
+  }
+
+  os << "  }\n";
+  os << "}\n";
+
+  return os.str();
+}
+
+}
@@ -0,0 +1,274 @@
+#include <CNES_Trace.h>
+#include <algorithm>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace CNES {
+
+const char Trace::s_magic[8] = { 'C', 'N', 'E', 'S', 'T', 'R', 'C', '\0' };
+
+Trace *Trace::s_crashTrace = nullptr;
+
+namespace {
+
+// dump file header
+struct Header {
+  char  magic[8];
+  uint  version   { 0 };
+  uint  eventSize { 0 };
+  ulong count     { 0 }; // events in file
+  ulong numEvents { 0 }; // events recorded (including overwritten)
+};
+
+}
+
+Trace::
+Trace(uint size)
+{
+  resize(size);
+}
+
+Trace::
+~Trace()
+{
+  if (s_crashTrace == this)
+    s_crashTrace = nullptr;
+}
+
+void
+Trace::
+setEnabled(bool b)
+{
+  if (b && events_.empty())
+    events_.resize(size());
+
+  enabled_ = b;
+}
+
+// set ring size (events discarded, only allocated if enabled)
+void
+Trace::
+resize(uint size)
+{
+  uint size1 = 1;
+
+  while (size1 < size)
+    size1 <<= 1;
+
+  Events().swap(events_);
+
+  if (enabled_)
+    events_.resize(size1);
+
+  mask_ = size1 - 1;
+  pos_  = 0;
+}
+
+void
+Trace::
+getEvents(Events &events, uint maxEvents) const
+{
+  ulong n = std::min(pos_, ulong(size()));
+
+  if (maxEvents > 0)
+    n = std::min(n, ulong(maxEvents));
+
+  events.resize(n);
+
+  ulong start = pos_ - n;
+
+  for (ulong i = 0; i < n; ++i)
+    events[i] = events_[(start + i) & mask_];
+}
+
+bool
+Trace::
+dump(const std::string &filename, uint maxEvents) const
+{
+  FILE *fp = fopen(filename.c_str(), "wb");
+  if (! fp) return false;
+
+  Events events;
+
+  getEvents(events, maxEvents);
+
+  Header header;
+
+  std::memcpy(header.magic, s_magic, sizeof(s_magic));
+
+  header.version   = s_version;
+  header.eventSize = sizeof(Event);
+  header.count     = events.size();
+  header.numEvents = pos_;
+
+  bool rc = (fwrite(&header, sizeof(header), 1, fp) == 1);
+
+  if (rc && ! events.empty())
+    rc = (fwrite(&events[0], sizeof(Event), events.size(), fp) == events.size());
+
+  fclose(fp);
+
+  return rc;
+}
+
+bool
+Trace::
+dump() const
+{
+  if (dumpFile_ == "")
+    return false;
+
+  return dump(dumpFile_);
+}
+
+//---
+
+void
+Trace::
+installCrashHandler()
+{
+  s_crashTrace = this;
+
+  signal(SIGSEGV, crashHandler);
+  signal(SIGBUS , crashHandler);
+  signal(SIGFPE , crashHandler);
+  signal(SIGILL , crashHandler);
+  signal(SIGABRT, crashHandler);
+}
+
+void
+Trace::
+crashHandler(int sig)
+{
+  if (s_crashTrace)
+    s_crashTrace->crashDump();
+
+  // re-raise with default handler (core dump etc)
+  signal(sig, SIG_DFL);
+
+  raise(sig);
+}
+
+void
+Trace::
+crashDump() const
+{
+  if (dumpFile_ == "")
+    return;
+
+  int fd = ::open(dumpFile_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return;
+
+  ulong n     = std::min(pos_, ulong(size()));
+  ulong start = pos_ - n;
+
+  Header header;
+
+  std::memcpy(header.magic, s_magic, sizeof(s_magic));
+
+  header.version   = s_version;
+  header.eventSize = sizeof(Event);
+  header.count     = n;
+  header.numEvents = pos_;
+
+  ssize_t rc = ::write(fd, &header, sizeof(header));
+
+  // ring in (at most) two contiguous parts
+  ulong i1 = start & mask_;
+  ulong n1 = std::min(n, ulong(size()) - i1);
+
+  if (rc >= 0 && n1 > 0)
+    rc = ::write(fd, &events_[i1], n1*sizeof(Event));
+
+  if (rc >= 0 && n > n1)
+    rc = ::write(fd, &events_[0], (n - n1)*sizeof(Event));
+
+  ::close(fd);
+}
+
+//---
+
+bool
+Trace::
+readFile(const std::string &filename, Events &events, ulong &numEvents)
+{
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (! fp) return false;
+
+  Header header;
+
+  bool rc = (fread(&header, sizeof(header), 1, fp) == 1 &&
+             std::memcmp(header.magic, s_magic, sizeof(s_magic)) == 0 &&
+             header.version == s_version && header.eventSize == sizeof(Event));
+
+  if (rc) {
+    events.resize(header.count);
+
+    if (header.count > 0)
+      rc = (fread(&events[0], sizeof(Event), header.count, fp) == header.count);
+
+    numEvents = header.numEvents;
+  }
+
+  fclose(fp);
+
+  return rc;
+}
+
+const char *
+Trace::
+kindName(Kind kind)
+{
+  switch (kind) {
+    case Kind::RAM_READ       : return "RAM_READ";
+    case Kind::IO_READ        : return "IO_READ";
+    case Kind::EXPANSION_READ : return "EXPANSION_READ";
+    case Kind::CART_RAM_READ  : return "CART_RAM_READ";
+    case Kind::ROM_READ       : return "ROM_READ";
+    case Kind::RAM_WRITE      : return "RAM_WRITE";
+    case Kind::IO_WRITE       : return "IO_WRITE";
+    case Kind::EXPANSION_WRITE: return "EXPANSION_WRITE";
+    case Kind::CART_RAM_WRITE : return "CART_RAM_WRITE";
+    case Kind::ROM_WRITE      : return "ROM_WRITE";
+    case Kind::PPU_READ       : return "PPU_READ";
+    case Kind::PPU_WRITE      : return "PPU_WRITE";
+    case Kind::SPRITE_READ    : return "SPRITE_READ";
+    case Kind::APU_WRITE      : return "APU_WRITE";
+    case Kind::MAPPER_WRITE   : return "MAPPER_WRITE";
+    case Kind::MARK           : return "MARK";
+    default                   : return "?";
+  }
+}
+
+void
+Trace::
+print(std::ostream &os, const Event &event)
+{
+  os << std::dec << std::setw(12) << std::setfill(' ') << event.cycle << " " <<
+        std::hex << std::setfill('0') <<
+        "PC=" << std::setw(4) << event.pc << " " <<
+        std::setw(4) << event.addr << " " <<
+        std::setw(2) << int(event.value) << " " <<
+        kindName(event.kind) << std::dec << std::setfill(' ') << "\n";
+}
+
+void
+Trace::
+echoEvent(ulong cycle, ushort pc, ushort addr, uchar value, Kind kind) const
+{
+  Event event;
+
+  event.cycle = cycle;
+  event.pc    = pc;
+  event.addr  = addr;
+  event.value = value;
+  event.kind  = kind;
+
+  print(std::cerr, event);
+}
+
+}
@@ -14,6 +14,7 @@
 #include <QCheckBox>
 #include <QLabel>
 #include <QGridLayout>
+#include <QTimer>
 
 using namespace CNES;
 
@@ -43,6 +44,14 @@ CQNESDbg(QMachine *machine) :
 
   connect(machine->getQPPU(), SIGNAL(memChangedSignal(ushort, ushort)),
           this, SLOT(updatePPUSlot(ushort, ushort)));
+
+  // change notifications are coalesced per frame, so also flush them
+  // periodically for when cpu is stepped in debugger
+  refreshTimer_ = new QTimer(this);
+
+  connect(refreshTimer_, SIGNAL(timeout()), this, SLOT(refreshSlot()));
+
+  refreshTimer_->start(100);
 }
 
 void
@@ -319,12 +328,27 @@ setTraced(bool traced)
 
 void
 CQNESDbg::
-updatePPUSlot(ushort addr, ushort /*len*/)
+refreshSlot()
+{
+  machine_->flushChanges();
+}
+
+void
+CQNESDbg::
+updatePPUSlot(ushort addr, ushort len)
 {
   if (ppuMemData_.group->isChecked()) {
     ppuMemData_.memArea->setMemoryLine(addr);
 
-    ppuMemData_.memArea->updateText(addr);
+    // update each memory line in changed range
+    uint addr1 = addr;
+    uint addr2 = addr + std::max(int(len), 1);
+
+    for (uint addr3 = addr1; addr3 < addr2; addr3 += 8)
+      ppuMemData_.memArea->updateText(addr3);
+
+    if ((addr2 - addr1) % 8)
+      ppuMemData_.memArea->updateText(addr2 - 1);
   }
 }
 
@@ -1,11 +1,943 @@
 #include <CNESTest.h>
+#include <CNES_CPU.h>
+#include <CNES_PPU.h>
+#include <CNES_AudioSink.h>
+#include <CNES_Image.h>
+#include <CNES_NTSC.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
 
 using namespace CNES;
 
+namespace {
+
+struct RenderOptions {
+  std::string outDir;
+  double      seconds { 180.0 };
+  int         song    { 0 };
+};
+
+std::mutex outputMutex;
+
+// file name without directory and extension
+std::string
+baseFileName(const std::string &filename)
+{
+  auto p = filename.rfind('/');
+
+  std::string baseName = (p != std::string::npos ? filename.substr(p + 1) : filename);
+
+  auto p1 = baseName.rfind('.');
+
+  if (p1 != std::string::npos)
+    baseName = baseName.substr(0, p1);
+
+  return baseName;
+}
+
+// directory of file name
+std::string
+dirFileName(const std::string &filename)
+{
+  auto p = filename.rfind('/');
+
+  return (p != std::string::npos ? filename.substr(0, p) : ".");
+}
+
+// render audio of ROM or NSF file to WAV file with video disabled
+bool
+renderWav(const std::string &filename, const RenderOptions &options)
+{
+  std::string wavName = baseFileName(filename) + ".wav";
+
+  if (options.outDir != "")
+    wavName = options.outDir + "/" + wavName;
+
+  //---
+
+  Machine machine;
+
+  machine.init();
+
+  machine.getPPU()->setVideoEnabled(false);
+
+  machine.pacer().setMode(Pacer::Mode::UNTHROTTLED);
+
+  auto *cart = machine.getCart();
+
+  if (! cart->load(filename)) {
+    std::unique_lock<std::mutex> lock(outputMutex);
+    std::cerr << "Failed to load '" << filename << "'\n";
+    return false;
+  }
+
+  WavAudioSink sink;
+
+  if (! sink.open(wavName)) {
+    std::unique_lock<std::mutex> lock(outputMutex);
+    std::cerr << "Failed to open '" << wavName << "'\n";
+    return false;
+  }
+
+  machine.setAudioSink(&sink);
+
+  if (cart->isNSF())
+    cart->initNSF(options.song);
+
+  auto *cpu = machine.getCPU();
+
+  cpu->resetSystem();
+
+  //---
+
+  auto t1 = std::chrono::steady_clock::now();
+
+  ulong numSamples = ulong(options.seconds*sink.sampleRate());
+
+  while (sink.numSamples() < numSamples) {
+    if (! machine.runFrame())
+      break;
+  }
+
+  machine.setAudioSink(nullptr);
+
+  sink.close();
+
+  auto t2 = std::chrono::steady_clock::now();
+
+  //---
+
+  double elapsed = std::chrono::duration<double>(t2 - t1).count();
+  double length  = double(sink.numSamples())/sink.sampleRate();
+
+  std::unique_lock<std::mutex> lock(outputMutex);
+
+  std::cout << wavName << ": " << length << "s in " << elapsed << "s (" <<
+    (elapsed > 0.0 ? length/elapsed : 0.0) << "x real time)\n";
+
+  return true;
+}
+
+//---
+
+// Golden frame hash regression
+//
+// Each ROM (<name>.nes) is run headless for the length of its input movie
+// (<name>.movie or <name>.fm2, or a fixed number of frames if none) and the
+// screen is hashed after each frame. Hashes are compared to <name>.golden
+// (one hex hash per line). The golden run also stores all frames (delta RLE)
+// in <name>.frames so that a mismatch can be written as expected, actual and
+// diff PNG images.
+
+// ppu render mode (default and per ROM overrides)
+struct PPUOptions {
+  PPU::RenderMode mode { PPU::RenderMode::SCANLINE };
+  std::string     overridesFile;
+};
+
+struct RegressOptions {
+  std::string goldenDir;           // golden files directory (default ROM directory)
+  std::string outDir;              // mismatch images directory (default current)
+  int         frames    { 600 };   // frames to run if no movie
+  bool        update    { false }; // write golden files instead of compare
+  PPUOptions  ppu;
+};
+
+// apply ppu options (before cartridge load)
+void
+initPPUOptions(Machine &machine, const PPUOptions &options)
+{
+  machine.setDefaultRenderMode(options.mode);
+
+  if (options.overridesFile != "" && ! machine.loadRenderOverrides(options.overridesFile)) {
+    std::unique_lock<std::mutex> lock(outputMutex);
+    std::cerr << "Failed to load '" << options.overridesFile << "'\n";
+  }
+}
+
+// per-frame controller 1 button state
+using Movie = std::vector<uchar>;
+
+// read movie: one frame per line as RLDUTSBA ('.' or ' ' released), FM2 lines
+// (|commands|RLDUTSBA|...) also supported
+bool
+readMovie(const std::string &filename, Movie &movie)
+{
+  std::ifstream is(filename);
+  if (! is) return false;
+
+  std::string line;
+
+  while (std::getline(is, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::string buttons = line;
+
+    if (line[0] == '|') {
+      auto p1 = line.find('|', 1);
+      if (p1 == std::string::npos) continue; // FM2 header line
+
+      auto p2 = line.find('|', p1 + 1);
+
+      buttons = line.substr(p1 + 1, p2 != std::string::npos ? p2 - p1 - 1 : std::string::npos);
+    }
+
+    uchar b = 0;
+
+    for (size_t i = 0; i < 8 && i < buttons.size(); ++i) {
+      if (buttons[i] != '.' && buttons[i] != ' ')
+        b |= uchar(0x80 >> i);
+    }
+
+    movie.push_back(b);
+  }
+
+  return true;
+}
+
+// read input movie for ROM (<name>.movie or <name>.fm2 in ROM directory)
+bool
+readROMMovie(const std::string &filename, Movie &movie)
+{
+  std::string baseName = dirFileName(filename) + "/" + baseFileName(filename);
+
+  return readMovie(baseName + ".movie", movie) || readMovie(baseName + ".fm2", movie);
+}
+
+// frames stored as runs of (count, xor with previous frame) pixels
+class FramesFile {
+ public:
+  using Pixels = std::vector<ushort>;
+
+ public:
+  FramesFile(int numPixels) :
+   numPixels_(numPixels), pixels_(numPixels, 0) {
+  }
+
+  void addFrame(const ushort *pixels) {
+    int i = 0;
+
+    while (i < numPixels_) {
+      ushort d = pixels[i] ^ pixels_[i];
+
+      int n = 1;
+
+      while (i + n < numPixels_ && n < 0xFFFF && (pixels[i + n] ^ pixels_[i + n]) == d)
+        ++n;
+
+      putShort(ushort(n));
+      putShort(d);
+
+      i += n;
+    }
+
+    memcpy(&pixels_[0], pixels, numPixels_*sizeof(ushort));
+  }
+
+  bool write(const std::string &filename) const {
+    std::ofstream os(filename, std::ios::binary);
+
+    os.write(reinterpret_cast<const char *>(&data_[0]), data_.size());
+
+    return bool(os);
+  }
+
+  // get pixels of frame (0 based)
+  bool readFrame(const std::string &filename, int frame, Pixels &pixels) {
+    std::ifstream is(filename, std::ios::binary);
+    if (! is) return false;
+
+    pixels.assign(numPixels_, 0);
+
+    for (int f = 0; f <= frame; ++f) {
+      int i = 0;
+
+      while (i < numPixels_) {
+        ushort nd[2];
+
+        if (! is.read(reinterpret_cast<char *>(nd), sizeof(nd)) || nd[0] == 0)
+          return false;
+
+        for (int j = 0; j < nd[0] && i < numPixels_; ++j, ++i)
+          pixels[i] ^= nd[1];
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  void putShort(ushort s) {
+    data_.push_back(uchar(s & 0xFF));
+    data_.push_back(uchar(s >> 8));
+  }
+
+ private:
+  int                numPixels_ { 0 };
+  Pixels             pixels_;
+  std::vector<uchar> data_;
+};
+
+// write expected, actual and diff (mismatched pixels red over dimmed expected) images
+void
+writeDiffImages(const std::string &prefix, const ushort *expected, const ushort *actual)
+{
+  int w = PPU::visiblePixels();
+  int h = PPU::visibleLines();
+
+  Image expectedImage(w, h), actualImage(w, h), diffImage(w, h);
+
+  if (expected)
+    expectedImage.setScreenPixels(expected);
+
+  actualImage.setScreenPixels(actual);
+
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      int i = y*w + x;
+
+      uchar r, g, b;
+
+      if (expected && expected[i] == actual[i]) {
+        expectedImage.getPixel(x, y, r, g, b);
+
+        diffImage.setPixel(x, y, r/4, g/4, b/4);
+      }
+      else
+        diffImage.setPixel(x, y, 255, 0, 0);
+    }
+  }
+
+  if (expected)
+    expectedImage.writePNG(prefix + "_expected.png");
+
+  actualImage.writePNG(prefix + "_actual.png");
+
+  if (expected)
+    diffImage.writePNG(prefix + "_diff.png");
+}
+
+// run ROM and compare (or store) per-frame screen hashes
+bool
+regressROM(const std::string &filename, const RegressOptions &options)
+{
+  std::string baseName  = baseFileName(filename);
+  std::string romDir    = dirFileName(filename);
+  std::string goldenDir = (options.goldenDir != "" ? options.goldenDir : romDir);
+
+  std::string goldenName = goldenDir + "/" + baseName + ".golden";
+  std::string framesName = goldenDir + "/" + baseName + ".frames";
+
+  auto report = [&](const std::string &msg) {
+    std::unique_lock<std::mutex> lock(outputMutex);
+
+    std::cout << baseName << ": " << msg << "\n";
+  };
+
+  //---
+
+  Movie movie;
+
+  readROMMovie(filename, movie);
+
+  //---
+
+  using Hashes = std::vector<ulong>;
+
+  Hashes goldenHashes;
+
+  if (! options.update) {
+    std::ifstream is(goldenName);
+
+    if (! is) {
+      report("no golden file '" + goldenName + "'");
+      return false;
+    }
+
+    std::string line;
+
+    while (std::getline(is, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      goldenHashes.push_back(std::stoul(line, nullptr, 16));
+    }
+  }
+
+  // no movie: run number of golden frames (or frames option when updating)
+  if (movie.empty())
+    movie.resize(options.update ? options.frames : int(goldenHashes.size()), 0);
+
+  //---
+
+  Machine machine;
+
+  machine.init();
+
+  machine.pacer().setMode(Pacer::Mode::UNTHROTTLED);
+
+  initPPUOptions(machine, options.ppu);
+
+  if (! machine.getCart()->load(filename)) {
+    report("failed to load");
+    return false;
+  }
+
+  auto *ppu = machine.getPPU();
+
+  int numPixels = PPU::visiblePixels()*PPU::visibleLines();
+
+  FramesFile framesFile(numPixels);
+
+  Hashes hashes;
+
+  machine.getCPU()->resetSystem();
+
+  for (const auto &buttons : movie) {
+    machine.input().setButtons(0, buttons);
+
+    if (! machine.runFrame())
+      break;
+
+    ulong hash = ppu->screenHash();
+
+    int frame = int(hashes.size());
+
+    hashes.push_back(hash);
+
+    if (options.update) {
+      framesFile.addFrame(ppu->screenPixels());
+      continue;
+    }
+
+    if (frame >= int(goldenHashes.size())) {
+      report("golden file too short (" + std::to_string(goldenHashes.size()) + " frames)");
+      return false;
+    }
+
+    if (hash != goldenHashes[frame]) {
+      std::string prefix = (options.outDir != "" ? options.outDir + "/" : "") +
+                           baseName + "_" + std::to_string(frame);
+
+      FramesFile::Pixels expected;
+
+      bool hasExpected = framesFile.readFrame(framesName, frame, expected);
+
+      writeDiffImages(prefix, hasExpected ? &expected[0] : nullptr, ppu->screenPixels());
+
+      report("FAIL first mismatch at frame " + std::to_string(frame) + " (" + prefix + "_*.png)");
+      return false;
+    }
+  }
+
+  //---
+
+  if (options.update) {
+    std::ofstream os(goldenName);
+
+    os << "# " << baseName << " screen hash per frame\n";
+
+    for (const auto &hash : hashes) {
+      char buffer[32];
+
+      snprintf(buffer, sizeof(buffer), "%016lx", hash);
+
+      os << buffer << "\n";
+    }
+
+    if (! os || ! framesFile.write(framesName)) {
+      report("failed to write golden files");
+      return false;
+    }
+
+    report("updated (" + std::to_string(hashes.size()) + " frames)");
+  }
+  else
+    report("ok (" + std::to_string(hashes.size()) + " frames)");
+
+  return true;
+}
+
+//---
+
+// Render backend timing comparison
+//
+// Runs ROM headless with the same input movie (or fixed number of frames) once
+// with each PPU render mode and reports frame rate of each and the frames where
+// the screen hashes differ.
+
+bool
+compareROM(const std::string &filename, int frames)
+{
+  std::string baseName = baseFileName(filename);
+
+  Movie movie;
+
+  if (! readROMMovie(filename, movie))
+    movie.resize(frames, 0);
+
+  struct Run {
+    PPU::RenderMode    mode    { PPU::RenderMode::SCANLINE };
+    double             elapsed { 0.0 };
+    std::vector<ulong> hashes;
+  };
+
+  Run runs[2];
+
+  runs[0].mode = PPU::RenderMode::SCANLINE;
+  runs[1].mode = PPU::RenderMode::DOT;
+
+  for (auto &run : runs) {
+    Machine machine;
+
+    machine.init();
+
+    machine.pacer().setMode(Pacer::Mode::UNTHROTTLED);
+
+    machine.setDefaultRenderMode(run.mode);
+
+    if (! machine.getCart()->load(filename)) {
+      std::cerr << "Failed to load '" << filename << "'\n";
+      return false;
+    }
+
+    auto *ppu = machine.getPPU();
+
+    machine.getCPU()->resetSystem();
+
+    auto t1 = std::chrono::steady_clock::now();
+
+    for (const auto &buttons : movie) {
+      machine.input().setButtons(0, buttons);
+
+      if (! machine.runFrame())
+        break;
+
+      run.hashes.push_back(ppu->screenHash());
+    }
+
+    auto t2 = std::chrono::steady_clock::now();
+
+    run.elapsed = std::chrono::duration<double>(t2 - t1).count();
+  }
+
+  //---
+
+  int numFrames = int(std::min(runs[0].hashes.size(), runs[1].hashes.size()));
+  int numDiff   = 0;
+  int firstDiff = -1;
+
+  for (int i = 0; i < numFrames; ++i) {
+    if (runs[0].hashes[i] != runs[1].hashes[i]) {
+      if (firstDiff < 0)
+        firstDiff = i;
+
+      ++numDiff;
+    }
+  }
+
+  std::cout << baseName << ":";
+
+  for (const auto &run : runs) {
+    double fps = (run.elapsed > 0.0 ? double(run.hashes.size())/run.elapsed : 0.0);
+
+    std::cout << " " << PPU::renderModeName(run.mode) << " " << fps << " fps";
+  }
+
+  if (runs[1].elapsed > 0.0)
+    std::cout << " (dot/scanline time " << runs[1].elapsed/std::max(runs[0].elapsed, 1e-9) << ")";
+
+  std::cout << ", " << numDiff << "/" << numFrames << " frames differ";
+
+  if (firstDiff >= 0)
+    std::cout << " (first " << firstDiff << ")";
+
+  std::cout << "\n";
+
+  return true;
+}
+
+//---
+
+// Sprite 0 hit and overflow check
+//
+// Randomized scenes (pattern, name table and palette data, scroll, mask, sprite 0
+// position/attributes/pattern and extra sprites on its lines) are drawn for a frame
+// with $2002 polled every cpu cycle. The first line showing sprite 0 hit must match
+// for scanline, scanline with frame skip and dot modes. The number of lines showing
+// sprite overflow must match for scanline with and without frame skip (dot mode
+// emulates the hardware evaluation bug so it can set overflow for 8 or less sprites).
+
+struct SpriteScene {
+  uchar scrollX { 0 };
+  uchar scrollY { 0 };
+  uchar mask    { 0x18 };
+  bool  tall    { false };
+  uchar oam[256];
+  uint  seed    { 0 }; // pattern, name table and palette data
+};
+
+struct SpriteResult {
+  int hitLine       { -1 };
+  int overflowLines { 0 };
+};
+
+SpriteResult
+runSpriteScene(const SpriteScene &scene, PPU::RenderMode mode, bool frameSkip)
+{
+  Machine machine;
+
+  machine.init();
+
+  machine.pacer().setMode(Pacer::Mode::UNTHROTTLED);
+
+  // NROM with vertical mirroring, PRG all NOPs and CHR RAM
+  std::vector<uchar> rom = { 0x4E, 0x45, 0x53, 0x1A, 1, 0, 0x01, 0, 1, 0, 0, 0, 0, 0, 0, 0 };
+
+  rom.resize(rom.size() + 16384, 0xEA);
+
+  machine.getCart()->loadNESData(rom);
+
+  auto *ppu = machine.getPPU();
+
+  ppu->setRenderMode(mode, /*immediate*/true);
+
+  std::mt19937 rand(scene.seed);
+
+  // sparse patterns so opaque pixels don't always overlap
+  for (int addr = 0; addr < 0x2000; ++addr) {
+    uint r = rand();
+
+    uchar b = uchar(r >> 16);
+
+    ppu->setByte(addr, (r & 0x100) ? uchar(b & (b >> 1) & (b >> 2)) : 0);
+  }
+
+  for (int addr = 0x2000; addr < 0x2800; ++addr)
+    ppu->setByte(addr, uchar(rand() & 0x3F));
+
+  for (int i = 0; i < 32; ++i)
+    ppu->setByte(0x3F00 + i, uchar(rand() & 0x3F));
+
+  ppu->setControlByte(0x2001, scene.mask);
+  ppu->setControlByte(0x2000, (scene.tall ? 0x20 : 0x00) | 0x08);
+
+  (void) ppu->getControlByte(0x2002);
+
+  ppu->setControlByte(0x2005, scene.scrollX);
+  ppu->setControlByte(0x2005, scene.scrollY);
+
+  ppu->setControlByte(0x2003, 0);
+
+  for (int i = 0; i < 256; ++i)
+    ppu->setControlByte(0x2004, scene.oam[i]);
+
+  ppu->setFrameSkip(frameSkip ? 1000 : 0);
+
+  // ends at frame wrap (line 0)
+  machine.runFrame();
+  machine.runFrame();
+
+  //---
+
+  SpriteResult result;
+
+  int lastOverflowLine = -1;
+
+  // poll each cpu cycle (3 dots) up to end of frame
+  for (long dots = 0; dots < long(PPU::numLines())*PPU::numPixels() - 3; ) {
+    ppu->tick(1);
+
+    dots += 3;
+
+    ppu->drawPendingLines();
+
+    int   line   = int(dots/PPU::numPixels()) - PPU::topMargin();
+    uchar status = ppu->getControlByte(0x2002);
+
+    if (line < 0 || line > PPU::visibleLines())
+      continue;
+
+    if ((status & 0x40) && result.hitLine < 0)
+      result.hitLine = line;
+
+    if ((status & 0x20) && line != lastOverflowLine) {
+      ++result.overflowLines;
+
+      lastOverflowLine = line;
+    }
+  }
+
+  return result;
+}
+
+bool
+spriteCheck(int numCases, uint seed)
+{
+  std::mt19937 rand(seed);
+
+  const uchar masks[] = { 0x18, 0x1E, 0x1A, 0x1C, 0x10, 0x08 };
+
+  int numHits     = 0;
+  int numMismatch = 0;
+
+  for (int i = 0; i < numCases; ++i) {
+    SpriteScene scene;
+
+    scene.scrollX = uchar(rand());
+    scene.scrollY = uchar(rand() % 240);
+    scene.mask    = masks[rand() % 6];
+    scene.tall    = (rand() & 1);
+    scene.seed    = rand();
+
+    int x = rand() & 0xFF;
+    int y = rand() % 240;
+
+    // favour sprite at left (clipped) and right (x=255) edges
+    if      (rand() % 4 == 0) x = 248 + rand() % 8;
+    else if (rand() % 4 == 0) x = rand() % 10;
+
+    memset(scene.oam, 0xF0, sizeof(scene.oam));
+
+    scene.oam[0] = uchar(y);
+    scene.oam[1] = uchar(rand());
+    scene.oam[2] = uchar(rand() & 0xE3);
+    scene.oam[3] = uchar(x);
+
+    // extra sprites overlapping sprite 0 lines (overflow when more than 8)
+    int numExtra = rand() % 12;
+
+    for (int j = 1; j <= numExtra; ++j) {
+      scene.oam[4*j + 0] = uchar(y + 2);
+      scene.oam[4*j + 1] = uchar(j);
+      scene.oam[4*j + 2] = 0;
+      scene.oam[4*j + 3] = uchar(j*20);
+    }
+
+    auto scanline = runSpriteScene(scene, PPU::RenderMode::SCANLINE, false);
+    auto skipped  = runSpriteScene(scene, PPU::RenderMode::SCANLINE, true );
+    auto dot      = runSpriteScene(scene, PPU::RenderMode::DOT     , false);
+
+    if (scanline.hitLine >= 0)
+      ++numHits;
+
+    if (skipped.hitLine       != scanline.hitLine       ||
+        dot    .hitLine       != scanline.hitLine       ||
+        skipped.overflowLines != scanline.overflowLines) {
+      if (numMismatch == 0)
+        std::cout << "case " << i << ": hit line " << scanline.hitLine <<
+                     " (skip " << skipped.hitLine << ", dot " << dot.hitLine << ")," <<
+                     " overflow lines " << scanline.overflowLines <<
+                     " (skip " << skipped.overflowLines << ")\n";
+
+      ++numMismatch;
+    }
+  }
+
+  std::cout << "sprite check: " << numCases << " cases (" << numHits << " hits), " <<
+               numMismatch << " mismatched\n";
+
+  return (numMismatch == 0);
+}
+
+//---
+
+// PNG frame export
+//
+// Each ROM is run headless for the length of its input movie (or a fixed number
+// of frames if none) and every nth frame (last frame if 0) is written as
+// <name>_<frame>.png, optionally through the NTSC composite filter (602 wide).
+
+struct ExportOptions {
+  std::string outDir;
+  int         frames      { 600 };
+  int         every       { 0 };     // write every n frames (0 last frame only)
+  bool        ntsc        { false }; // NTSC filter
+  int         ntscThreads { 0 };     // filter threads (0 cpu count)
+  PPUOptions  ppu;
+};
+
+bool
+exportROM(const std::string &filename, const ExportOptions &options)
+{
+  std::string baseName = baseFileName(filename);
+
+  auto report = [&](const std::string &msg) {
+    std::unique_lock<std::mutex> lock(outputMutex);
+
+    std::cout << baseName << ": " << msg << "\n";
+  };
+
+  Movie movie;
+
+  readROMMovie(filename, movie);
+
+  if (movie.empty())
+    movie.resize(options.frames, 0);
+
+  //---
+
+  Machine machine;
+
+  machine.init();
+
+  machine.pacer().setMode(Pacer::Mode::UNTHROTTLED);
+
+  initPPUOptions(machine, options.ppu);
+
+  if (! machine.getCart()->load(filename)) {
+    report("failed to load");
+    return false;
+  }
+
+  auto *ppu = machine.getPPU();
+
+  int w = PPU::visiblePixels();
+  int h = PPU::visibleLines();
+
+  std::unique_ptr<NTSCFilter> filter;
+
+  if (options.ntsc)
+    filter = std::make_unique<NTSCFilter>(options.ntscThreads);
+
+  int                iw = (filter ? NTSCFilter::outputWidth(w) : w);
+  std::vector<uchar> rgba(size_t(iw)*h*4);
+
+  auto writeFrame = [&](int frame) {
+    Image image(iw, h);
+
+    if (filter) {
+      filter->filter(ppu->screenPixels(), w, h, w, ppu->frameNum(),
+                     Palette::Format::RGBA8888, &rgba[0], iw*4);
+
+      image.setRGBAPixels(&rgba[0], iw*4);
+    }
+    else
+      image.setScreenPixels(ppu->screenPixels());
+
+    std::string pngName = (options.outDir != "" ? options.outDir + "/" : "") +
+                          baseName + "_" + std::to_string(frame) + ".png";
+
+    return image.writePNG(pngName);
+  };
+
+  machine.getCPU()->resetSystem();
+
+  int numFrames  = 0;
+  int numWritten = 0;
+
+  for (const auto &buttons : movie) {
+    machine.input().setButtons(0, buttons);
+
+    if (! machine.runFrame())
+      break;
+
+    ++numFrames;
+
+    bool last = (numFrames == int(movie.size()));
+
+    if ((options.every > 0 && numFrames % options.every == 0) || (options.every <= 0 && last)) {
+      if (! writeFrame(numFrames)) {
+        report("failed to write frame " + std::to_string(numFrames));
+        return false;
+      }
+
+      ++numWritten;
+    }
+  }
+
+  report(std::to_string(numWritten) + " frames written (" + std::to_string(numFrames) +
+         " frames run)");
+
+  return true;
+}
+
+//---
+
+// ROM files of directory (sorted)
+void
+dirROMs(const std::string &dir, std::vector<std::string> &files)
+{
+  std::vector<std::string> files1;
+
+  std::error_code ec;
+
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    if (entry.path().extension() == ".nes")
+      files1.push_back(entry.path().string());
+  }
+
+  std::sort(files1.begin(), files1.end());
+
+  files.insert(files.end(), files1.begin(), files1.end());
+}
+
+// files processed at a time by processFiles
+int
+numFileWorkers(const std::vector<std::string> &files, int threads)
+{
+  return std::min(std::max(threads, 1), std::max(int(files.size()), 1));
+}
+
+// process files in parallel (one machine per file), returns number of failures
+int
+processFiles(const std::vector<std::string> &files, int threads,
+             const std::function<bool (const std::string &)> &proc)
+{
+  threads = numFileWorkers(files, threads);
+
+  std::atomic<size_t> nextFile { 0 };
+  std::atomic<int>    numFailed { 0 };
+
+  auto worker = [&]() {
+    size_t i;
+
+    while ((i = nextFile++) < files.size()) {
+      if (! proc(files[i]))
+        ++numFailed;
+    }
+  };
+
+  std::vector<std::thread> workers;
+
+  for (int i = 0; i < threads; ++i)
+    workers.emplace_back(worker);
+
+  for (auto &worker : workers)
+    worker.join();
+
+  return numFailed;
+}
+
+}
+
 int
 main(int argc, char **argv)
 {
-  bool debug = false;
+  bool debug   = false;
+  bool wav     = false;
+  bool regress = false;
+  bool compare = false;
+  bool png     = false;
+  int  threads = int(std::thread::hardware_concurrency());
+
+  int  spriteCases = 0;
+  uint spriteSeed  = 1;
+
+  RenderOptions  renderOptions;
+  RegressOptions regressOptions;
+  ExportOptions  exportOptions;
 
   using Args = std::vector<std::string>;
 
@@ -15,8 +947,70 @@ main(int argc, char **argv)
     if (argv[i][0] == '-') {
       std::string arg = &argv[i][1];
 
-      if (arg == "D")
+      if      (arg == "D")
         debug = true;
+      else if (arg == "wav")
+        wav = true;
+      else if (arg == "regress")
+        regress = true;
+      else if (arg == "update")
+        regressOptions.update = true;
+      else if (arg == "compare")
+        compare = true;
+      else if (arg == "png")
+        png = true;
+      else if (arg == "every") {
+        if (i < argc - 1)
+          exportOptions.every = std::atoi(argv[++i]);
+      }
+      else if (arg == "ntsc")
+        exportOptions.ntsc = true;
+      else if (arg == "ppu") {
+        if (i < argc - 1) {
+          if (! PPU::nameToRenderMode(argv[++i], regressOptions.ppu.mode)) {
+            std::cerr << "Invalid render mode '" << argv[i] << "'\n";
+            exit(1);
+          }
+        }
+      }
+      else if (arg == "ppu_overrides") {
+        if (i < argc - 1)
+          regressOptions.ppu.overridesFile = argv[++i];
+      }
+      else if (arg == "golden") {
+        if (i < argc - 1)
+          regressOptions.goldenDir = argv[++i];
+      }
+      else if (arg == "frames") {
+        if (i < argc - 1)
+          regressOptions.frames = std::atoi(argv[++i]);
+      }
+      else if (arg == "outdir") {
+        if (i < argc - 1) {
+          renderOptions .outDir = argv[++i];
+          regressOptions.outDir = renderOptions.outDir;
+        }
+      }
+      else if (arg == "seconds") {
+        if (i < argc - 1)
+          renderOptions.seconds = std::atof(argv[++i]);
+      }
+      else if (arg == "song") {
+        if (i < argc - 1)
+          renderOptions.song = std::atoi(argv[++i]);
+      }
+      else if (arg == "threads") {
+        if (i < argc - 1)
+          threads = std::atoi(argv[++i]);
+      }
+      else if (arg == "sprite_check") {
+        if (i < argc - 1)
+          spriteCases = std::atoi(argv[++i]);
+      }
+      else if (arg == "seed") {
+        if (i < argc - 1)
+          spriteSeed = uint(std::atoi(argv[++i]));
+      }
       else {
         std::cerr << "Invalid arg '" << argv[i] << "'\n";
         exit(1);
@@ -29,6 +1023,69 @@ main(int argc, char **argv)
 
   //---
 
+  // randomized sprite 0 hit and overflow comparison of render modes
+  if (spriteCases > 0)
+    exit(spriteCheck(spriteCases, spriteSeed) ? 0 : 1);
+
+  // render each file to WAV (files processed in parallel, one machine per file)
+  if (wav) {
+    int numFailed = processFiles(args, threads, [&](const std::string &filename) {
+      return renderWav(filename, renderOptions);
+    });
+
+    exit(numFailed > 0 ? 1 : 0);
+  }
+
+  // ROM files and directories
+  std::vector<std::string> files;
+
+  for (const auto &arg : args) {
+    if (std::filesystem::is_directory(arg))
+      dirROMs(arg, files);
+    else
+      files.push_back(arg);
+  }
+
+  // compare render backend timing (one ROM at a time so timings don't interfere)
+  if (compare) {
+    int numFailed = 0;
+
+    for (const auto &file : files) {
+      if (! compareROM(file, regressOptions.frames))
+        ++numFailed;
+    }
+
+    exit(numFailed > 0 ? 1 : 0);
+  }
+
+  // export frames as PNG (files processed in parallel, single threaded filter
+  // per file when more than one file is processed at a time)
+  if (png) {
+    exportOptions.outDir      = regressOptions.outDir;
+    exportOptions.frames      = regressOptions.frames;
+    exportOptions.ppu         = regressOptions.ppu;
+    exportOptions.ntscThreads = (numFileWorkers(files, threads) > 1 ? 1 : 0);
+
+    int numFailed = processFiles(files, threads, [&](const std::string &filename) {
+      return exportROM(filename, exportOptions);
+    });
+
+    exit(numFailed > 0 ? 1 : 0);
+  }
+
+  // run golden frame hash regression
+  if (regress) {
+    int numFailed = processFiles(files, threads, [&](const std::string &filename) {
+      return regressROM(filename, regressOptions);
+    });
+
+    std::cout << files.size() - numFailed << "/" << files.size() << " passed\n";
+
+    exit(numFailed > 0 ? 1 : 0);
+  }
+
+  //---
+
   Machine machine;
 
   machine.init();
@@ -36,6 +1093,8 @@ main(int argc, char **argv)
   if (debug)
     machine.setDebugWrite(true);
 
+  initPPUOptions(machine, regressOptions.ppu);
+
   auto cart = machine.getCart();
 
   for (const auto &arg : args) {
@@ -0,0 +1,73 @@
+#include <CNES_Trace.h>
+#include <iostream>
+#include <cstdlib>
+
+using namespace CNES;
+
+// decode binary trace dump to text
+int
+main(int argc, char **argv)
+{
+  uint        last = 0;
+  int         addr = -1;
+  std::string kind;
+  std::string filename;
+
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      std::string arg = &argv[i][1];
+
+      if      (arg == "last") {
+        if (i < argc - 1)
+          last = uint(std::atoi(argv[++i]));
+      }
+      else if (arg == "addr") {
+        if (i < argc - 1)
+          addr = int(std::strtol(argv[++i], nullptr, 16));
+      }
+      else if (arg == "kind") {
+        if (i < argc - 1)
+          kind = argv[++i];
+      }
+      else {
+        std::cerr << "Invalid arg '" << argv[i] << "'\n";
+        exit(1);
+      }
+    }
+    else
+      filename = argv[i];
+  }
+
+  if (filename == "") {
+    std::cerr << "Usage: CNESTraceDecode [-last <n>] [-addr <hex>] [-kind <name>] <file>\n";
+    exit(1);
+  }
+
+  //---
+
+  Trace::Events events;
+  ulong         numEvents = 0;
+
+  if (! Trace::readFile(filename, events, numEvents)) {
+    std::cerr << "Failed to read '" << filename << "'\n";
+    exit(1);
+  }
+
+  std::cout << "# " << events.size() << " of " << numEvents << " events\n";
+
+  size_t start = (last > 0 && last < events.size() ? events.size() - last : 0);
+
+  for (size_t i = start; i < events.size(); ++i) {
+    const auto &event = events[i];
+
+    if (addr >= 0 && event.addr != addr)
+      continue;
+
+    if (kind != "" && kind != Trace::kindName(event.kind))
+      continue;
+
+    Trace::print(std::cout, event);
+  }
+
+  exit(0);
+}